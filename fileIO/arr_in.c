@@ -1,14 +1,20 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // these preprocesser definitions make typing/reading the code easier
 #define print_rational(x) printf("%d/%d", (x)->numerator, (x)->denominator);
 #define MIN(x, y) (x < y) ? x : y
 #define MAX(x, y) (x > y) ? x : y
-#define DIVIDE_BY_DIVISOR(a,b,c,d,divisor) \
-    a /= divisor; \
-    b /= divisor; \
-    c /= divisor; \
-    d /= divisor; \
 
 // used ot format columns in print statement
 #define FORMAT_COL 6
@@ -16,6 +22,9 @@
 // 2^31 - 1
 #define INT_MAX 2147483647
 
+// size of the buffer used by the scanner when the input can't be mmap'd (pipes, stdin)
+#define CHUNK_SIZE (1 << 20)
+
 
 // struct rational typedef to rational
 // this is the data structure used to represent fractions
@@ -44,54 +53,314 @@ void read_file(FILE *f, rational (*arr)[]) {
 }
 
 
-// adds rationals represented by {num1, den1}, {num2, den2} adjusting accuracy if numerator or
-// denominator > INT_MAX
+// struct scanner typedef to scanner
+// input source for scan_int(). regular files are mmap'd so buf covers the whole file and nothing is copied,
+// anything else (pipes, stdin) is read CHUNK_SIZE bytes at a time into chunk
+typedef struct scanner {
+    const char *buf;   // bytes the scanner can currently see
+    size_t len;        // number of valid bytes in buf
+    size_t pos;        // index of the next unread byte in buf
+    size_t base;       // byte offset of buf[0] in the whole input (used for error messages)
+    FILE *f;           // stream chunks are read from (NULL when mmap'd)
+    char *chunk;       // heap buffer for chunked reads (NULL when mmap'd)
+    void *map;         // mmap'd region (NULL when chunked)
+    size_t map_len;    // length of the mmap'd region
+    size_t err_offset; // byte offset of the last parse error
+} scanner;
+
+
+// opens path for scanning, mmap'ing it if it's a regular file and falling back to chunked reads otherwise
 // -
 // args:
-// rational *r: pointer to rational that stores the sum
-// int num1: numerator of first addend
-// int num2: numerator of second addend
-// int den1: denominator of first addend
-// int den2: denominator of second addend
-// - 
+// scanner *s: pointer to scanner to be set up
+// const char *path: file to read, "-" reads from stdin
+// -
 // returns:
-// nothing, results are stored in *r
-void rational_add(rational *r, int num1, int num2, int den1, int den2) {
-    int prod1 = 0;
-    int prod2 = 0;
-    int den_prod = 0;
-    int divisor = 2;
-    if (num1 != 0 && den2 != 0) {
-        while ((INT_MAX / num1) / den2 == 0) {
-            DIVIDE_BY_DIVISOR(num1,num2,den1,den2,divisor)
+// 0 on success, -1 if the file couldn't be opened
+int scanner_open(scanner *s, const char *path) {
+    *s = (scanner) {0};
+    if (path[0] == '-' && path[1] == '\0') {
+        s->f = stdin;
+    }
+    else {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return -1;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+                madvise(map, st.st_size, MADV_SEQUENTIAL); // only a hint, strict -std=c11 builds don't declare it
+#endif
+                close(fd);
+                s->map = map;
+                s->map_len = st.st_size;
+                s->buf = map;
+                s->len = st.st_size;
+                return 0;
+            }
+        }
+        s->f = fdopen(fd, "r");
+        if (s->f == NULL) {
+            close(fd);
+            return -1;
         }
-        prod1  = num1 * den2;
     }
+    s->chunk = malloc(CHUNK_SIZE);
+    if (s->chunk == NULL) {
+        if (s->f != stdin) fclose(s->f);
+        return -1;
+    }
+    s->buf = s->chunk;
+    return 0;
+}
+
+
+// releases whatever scanner_open() set up
+void scanner_close(scanner *s) {
+    if (s->map != NULL) munmap(s->map, s->map_len);
+    if (s->f != NULL && s->f != stdin) fclose(s->f);
+    free(s->chunk);
+    *s = (scanner) {0};
+}
+
+
+// reads the next chunk of input once the scanner has consumed the current one
+// -
+// returns:
+// 1 if more bytes are available, 0 at end of input (always 0 when mmap'd since buf is the whole file)
+int scanner_refill(scanner *s) {
+    if (s->f == NULL) return 0;
+    s->base += s->len;
+    s->pos = 0;
+    s->len = fread(s->chunk, 1, CHUNK_SIZE, s->f);
+    return s->len > 0;
+}
+
+
+// whitespace as defined by isspace() in the "C" locale, without going through the locale tables
+#define IS_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+
+// hand-written replacement for fscanf(f, "%d", ...) - skips whitespace and parses one signed decimal int
+// -
+// args:
+// scanner *s: input source
+// int *out: pointer to int that stores the parsed value
+// -
+// returns:
+// 1 if a value was stored in *out, 0 at end of input, -1 on a parse error (non-digit characters or a value that
+// doesn't fit in an int). on error s->err_offset holds the byte offset of the offending token
+// -
+// the value is accumulated across scanner_refill() calls so a number split between two chunks parses correctly
+int scan_int(scanner *s, int *out) {
+    int c;
+    for (;;) {
+        if (s->pos == s->len && !scanner_refill(s)) return 0;
+        c = s->buf[s->pos];
+        if (!IS_SPACE(c)) break;
+        s->pos++;
+    }
+
+    size_t start = s->base + s->pos;
+    int negative = (c == '-');
+    if (c == '-' || c == '+') s->pos++;
 
-    if (num2 != 0 && den1 != 0) {
-        while ((INT_MAX / num2) / den1 == 0) {
-            DIVIDE_BY_DIVISOR(num1,num2,den1,den2,divisor)
+    long long value = 0;
+    int digits = 0;
+    for (;;) {
+        if (s->pos == s->len && !scanner_refill(s)) break;
+        unsigned d = (unsigned char) s->buf[s->pos] - '0';
+        if (d > 9) break;
+        value = value * 10 + d;
+        if (value > (long long) INT_MAX + negative) {
+            s->err_offset = start;
+            return -1;
         }
-        prod2  = num2 * den1;
+        digits++;
+        s->pos++;
     }
-    while ((INT_MAX / den2) / den1 == 0) {
-        DIVIDE_BY_DIVISOR(num1,num2,den1,den2,divisor)
+    if (digits == 0) {
+        s->err_offset = start;
+        return -1;
     }
-    den_prod = den1 * den2;
-    
-    while (INT_MAX - prod1 - prod2 <= 0) {
-        prod1 /= 4;
-        prod2 /= 4;
-        den_prod /= 4;
+    if (s->pos < s->len && !IS_SPACE(s->buf[s->pos])) {
+        s->err_offset = s->base + s->pos;
+        return -1;
     }
-    
-    r->numerator = prod1 + prod2;
-    r->denominator = den_prod;
-}   
+    *out = (int) (negative ? -value : value);
+    return 1;
+}
+
+
+// fast replacement for read_file() - parses pairs of values straight into arr using scan_int()
+// -
+// args:
+// scanner *s: input source
+// rational *arr: array with room for at least n rationals
+// int n: max number of rationals to read
+// -
+// returns
+// number of complete rationals stored in arr, or -1 on a parse error (see scan_int())
+int read_file_fast(scanner *s, rational *arr, int n) {
+    int count = 0;
+    while (count < n) {
+        int loop = scan_int(s, &arr[count].numerator);
+        if (loop == 0) break;
+        if (loop == 1) loop = scan_int(s, &arr[count].denominator);
+        if (loop == -1) return -1;
+        if (loop == 0) break;
+        count++;
+    }
+    return count;
+}
+
+
+// status codes returned by the arithmetic functions below
+#define RATIONAL_OK 0
+#define RATIONAL_OVERFLOW 1        // exact result doesn't fit in the destination type
+#define RATIONAL_ZERO_DENOMINATOR 2 // an operand (or the result) has a denominator of 0
+
+// largest magnitude the 64 bit kernel will produce - INT64_MIN is left out so negating a result is always safe
+#define RATIONAL64_MAX 9223372036854775807LL
+
+
+// find greatest common divisor of two 64 bit numbers (binary gcd, same algorithm as gcd() below)
+long long gcd64(long long n1, long long n2) {
+    unsigned long long a = (n1 < 0) ? -(unsigned long long) n1 : (unsigned long long) n1;
+    unsigned long long b = (n2 < 0) ? -(unsigned long long) n2 : (unsigned long long) n2;
+    if (a == 0) return (long long) b;
+    if (b == 0) return (long long) a;
+    int shift = __builtin_ctzll(a | b);
+    int az = __builtin_ctzll(a);
+    b >>= __builtin_ctzll(b);
+    while (a != 0) {
+        a >>= az;
+        unsigned long long diff = b - a;
+        az = __builtin_ctzll(diff | 0x8000000000000000ull);
+        unsigned long long lo = (a < b) ? a : b;
+        a = (a < b) ? diff : a - b;
+        b = lo;
+    }
+    return (long long) (b << shift);
+}
+
+
+// find greatest common divisor of two 128 bit numbers, only used when a result has to be fully reduced before
+// checking whether it fits in 64 bits
+unsigned __int128 gcd128(unsigned __int128 a, unsigned __int128 b) {
+    while (b != 0) {
+        unsigned __int128 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+// stores the 128 bit fraction num/den in *n/*d with a positive denominator, reducing it first if it doesn't fit
+// -
+// returns:
+// RATIONAL_OK, or RATIONAL_OVERFLOW if even the reduced fraction doesn't fit in 64 bits (*n/*d untouched)
+int rational64_narrow(__int128 num, __int128 den, long long *n, long long *d) {
+    if (den < 0) {
+        num = -num;
+        den = -den;
+    }
+    if (num == 0) den = 1;
+    if (num > RATIONAL64_MAX || num < -RATIONAL64_MAX || den > RATIONAL64_MAX) {
+        unsigned __int128 g = gcd128((num < 0) ? -(unsigned __int128) num : (unsigned __int128) num, den);
+        num /= (__int128) g;
+        den /= (__int128) g;
+        if (num > RATIONAL64_MAX || num < -RATIONAL64_MAX || den > RATIONAL64_MAX) return RATIONAL_OVERFLOW;
+    }
+    *n = (long long) num;
+    *d = (long long) den;
+    return RATIONAL_OK;
+}
+
+
+// exact 64 bit addition kernel: {num1, den1} + {num2, den2} using 128 bit intermediates
+// -
+// args:
+// long long num1, den1: first addend
+// long long num2, den2: second addend
+// long long *n, *d: pointers that store the numerator/denominator of the sum
+// -
+// returns:
+// RATIONAL_OK, RATIONAL_OVERFLOW or RATIONAL_ZERO_DENOMINATOR. nothing is approximated, on error *n/*d are untouched
+// -
+// the denominators are divided by g = gcd(den1, den2) before cross-multiplying so the products stay small, then
+// the sum only has to be reduced by gcd(sum, g) (any other common factor would have to divide den1/g or den2/g,
+// which are coprime to the numerators if the inputs are in lowest terms). the result is in lowest terms whenever
+// the inputs are
+int rational64_add(long long num1, long long den1, long long num2, long long den2, long long *n, long long *d) {
+    if (den1 == 0 || den2 == 0) return RATIONAL_ZERO_DENOMINATOR;
+    long long g = gcd64(den1, den2);
+    __int128 num = (__int128) num1 * (den2 / g) + (__int128) num2 * (den1 / g);
+    long long g2 = gcd64((long long) (num % g), g);
+    __int128 den = (__int128) (den1 / g) * (den2 / g2);
+    return rational64_narrow(num / g2, den, n, d);
+}
+
+
+// exact 64 bit multiplication kernel: {num1, den1} * {num2, den2} using 128 bit intermediates
+// -
+// args:
+// long long num1, den1: first multiplier
+// long long num2, den2: second multiplier
+// long long *n, *d: pointers that store the numerator/denominator of the product
+// -
+// returns:
+// RATIONAL_OK, RATIONAL_OVERFLOW or RATIONAL_ZERO_DENOMINATOR. nothing is approximated, on error *n/*d are untouched
+// -
+// cross-reduces by gcd(num1, den2) and gcd(num2, den1) before multiplying, so the product is in lowest terms
+// whenever the inputs are and never gets bigger than it has to
+int rational64_multiply(long long num1, long long den1, long long num2, long long den2, long long *n, long long *d) {
+    if (den1 == 0 || den2 == 0) return RATIONAL_ZERO_DENOMINATOR;
+    long long g1 = gcd64(num1, den2);
+    long long g2 = gcd64(num2, den1);
+    if (g1 == 0) g1 = 1;
+    if (g2 == 0) g2 = 1;
+    __int128 num = (__int128) (num1 / g1) * (num2 / g2);
+    __int128 den = (__int128) (den1 / g2) * (den2 / g1);
+    return rational64_narrow(num, den, n, d);
+}
+
+
+// narrows a 64 bit kernel result into an int rational
+// -
+// returns:
+// RATIONAL_OK, or RATIONAL_OVERFLOW if num/den don't fit in an int (*r untouched)
+int rational_narrow(rational *r, long long num, long long den) {
+    if (num > INT_MAX || num < -INT_MAX || den > INT_MAX) return RATIONAL_OVERFLOW;
+    r->numerator = (int) num;
+    r->denominator = (int) den;
+    return RATIONAL_OK;
+}
+
+
+// adds rationals represented by {num1, den1}, {num2, den2} exactly, using rational64_add()
+// -
+// args:
+// rational *r: pointer to rational that stores the sum
+// int num1: numerator of first addend
+// int num2: numerator of second addend
+// int den1: denominator of first addend
+// int den2: denominator of second addend
+// - 
+// returns:
+// RATIONAL_OK, RATIONAL_OVERFLOW if the exact sum doesn't fit in an int, or RATIONAL_ZERO_DENOMINATOR.
+// on error *r is untouched
+int rational_add(rational *r, int num1, int num2, int den1, int den2) {
+    long long n, d;
+    int status = rational64_add(num1, den1, num2, den2, &n, &d);
+    if (status != RATIONAL_OK) return status;
+    return rational_narrow(r, n, d);
+}
 
 
-// multiplies two rationals represented by {num1, den1}, {num2, den2}, adjusting accuracy if either the numerator
-// or denominator exceed INT_MAX
+// multiplies two rationals represented by {num1, den1}, {num2, den2} exactly, using rational64_multiply()
 // -
 // args:
 // rational *r: pointer to rational that stores product
@@ -101,28 +370,18 @@ void rational_add(rational *r, int num1, int num2, int den1, int den2) {
 // int den2: denominator of second multiplier
 // - 
 // returns:
-// nothing, results stored in *r
-void rational_multiply(rational *r, int num1, int num2, int den1, int den2) {
-    int prod1 = 0;
-    int den_prod = 0;
-    int divisor = 2;
-    if (num1 != 0 && num2 != 0) {
-        while ((INT_MAX / num1) / num2 == 0) {
-            DIVIDE_BY_DIVISOR(num1,num2,den1,den2,divisor)
-        }
-        prod1  = num1 * num2;
-    }
-    while ((INT_MAX / den2) / den1 == 0) {
-        DIVIDE_BY_DIVISOR(num1,num2,den1,den2,divisor)
-    }
-    den_prod = den1 * den2;
-
-    r->numerator = prod1;
-    r->denominator = den_prod;
+// RATIONAL_OK, RATIONAL_OVERFLOW if the exact product doesn't fit in an int, or RATIONAL_ZERO_DENOMINATOR.
+// on error *r is untouched
+int rational_multiply(rational *r, int num1, int num2, int den1, int den2) {
+    long long n, d;
+    int status = rational64_multiply(num1, den1, num2, den2, &n, &d);
+    if (status != RATIONAL_OK) return status;
+    return rational_narrow(r, n, d);
 }
 
 
-// find greatest common divisor of two numbers
+// find greatest common divisor of two numbers with the Euclidean algorithm
+// (this was gcd() before the binary version below replaced it, it's kept for the benchmark in gcd_benchmark())
 // -
 // args:
 // int n1: num 1
@@ -138,7 +397,7 @@ void rational_multiply(rational *r, int num1, int num2, int den1, int den2) {
 // due to this, if n3 = n2 % n1 AND n3 != 0
 // gcd(n1, n2) = gcd(n3, n1) = gcd(n3, n2)
 // then you use a while loop and return the gcd
-int gcd(int n1, int n2) {
+int gcd_euclid(int n1, int n2) {
     if (n1 < 0) n1 *= -1;
     if (n2 < 0) n2 *= -1;
     int max, min;
@@ -153,22 +412,137 @@ int gcd(int n1, int n2) {
 }
 
 
+// find greatest common divisor of two numbers with the binary (Stein's) algorithm
+// -
+// args:
+// int n1: num 1
+// int n2: num 2
+// -
+// returns:
+// greatest common divisor (0 if both are 0)
+// -
+// uses no division at all:
+// gcd(2a, 2b) = 2 * gcd(a, b), so the common factors of 2 are counted once with ctz (count trailing zeros)
+// gcd(a, 2b) = gcd(a, b) when a is odd, so every other factor of 2 can just be shifted out
+// gcd(a, b) = gcd(a, b - a) when both are odd, and b - a is even so the next shift makes progress
+int gcd(int n1, int n2) {
+    unsigned int a = (n1 < 0) ? -(unsigned int) n1 : (unsigned int) n1;
+    unsigned int b = (n2 < 0) ? -(unsigned int) n2 : (unsigned int) n2;
+    if (a == 0) return (int) b;
+    if (b == 0) return (int) a;
+    int shift = __builtin_ctz(a | b);
+    int az = __builtin_ctz(a);
+    b >>= __builtin_ctz(b);
+    // b is always odd here. the ctz for the next a is taken from b - a directly (same trailing zeros as |b - a|)
+    // so it doesn't have to wait for the min/abs below, which keeps the chain of dependent steps short.
+    // | 0x80000000 keeps ctz defined when b == a, the loop ends then anyway
+    while (a != 0) {
+        a >>= az;
+        unsigned int diff = b - a;
+        az = __builtin_ctz(diff | 0x80000000u);
+        unsigned int lo = (a < b) ? a : b;
+        a = (a < b) ? diff : a - b;
+        b = lo;
+    }
+    return (int) (b << shift);
+}
+
+
 // simplifies fraction
 // - 
 // args:
 // rational *r: pointer to rational to be simplified
 // - 
 // returns;
-// nothing, *r is simplified in-place
+// nothing, *r is simplified in-place (0/0 is left alone)
 // -
-// uses gcd() function (line 141)
+// uses gcd() function
 void simplify(rational *r) {
     int divisor = gcd(r->numerator, r->denominator);
+    if (divisor == 0) return;
+    r->numerator /= divisor;
+    r->denominator /= divisor;
+}
+
+
+// sets up one lane of simplify_batch(): a = |numerator|, b = |denominator| with its factors of 2 shifted out,
+// shift = common factors of 2, az = trailing zeros of a (same start as gcd()). gcd(x, 0) = x, so a lane with a
+// 0 in it is parked with the answer already in b and a = 0
+void gcd_lane_init(const rational *r, unsigned int *a, unsigned int *b, int *shift, int *az) {
+    *a = (r->numerator < 0) ? -(unsigned int) r->numerator : (unsigned int) r->numerator;
+    *b = (r->denominator < 0) ? -(unsigned int) r->denominator : (unsigned int) r->denominator;
+    if (*a == 0 || *b == 0) {
+        *b |= *a;
+        *a = 0;
+        *shift = 0;
+        *az = 0;
+        return;
+    }
+    *shift = __builtin_ctz(*a | *b);
+    *az = __builtin_ctz(*a);
+    *b >>= __builtin_ctz(*b);
+}
+
+
+// one step of the loop in gcd(), written without branches so a lane that's already finished (a == 0) just
+// leaves a and b alone instead of mispredicting
+#define GCD_LANE_STEP(a, b, az) do { \
+    unsigned int ak_ = (a) >> (az); \
+    unsigned int diff_ = (b) - ak_; \
+    unsigned int lt_ = ak_ < (b); \
+    unsigned int live_ = -(unsigned int) (ak_ != 0); \
+    unsigned int lo_ = lt_ ? ak_ : (b); \
+    (az) = __builtin_ctz(diff_ | 0x80000000u); \
+    (a) = (lt_ ? diff_ : ak_ - (b)) & live_; \
+    (b) = (lo_ & live_) | ((b) & ~live_); \
+} while (0)
+
+
+// divides r by the gcd a lane ended up with (b << shift)
+void gcd_lane_finish(rational *r, unsigned int b, int shift) {
+    int divisor = (int) (b << shift);
+    if (divisor == 0) return;
     r->numerator /= divisor;
     r->denominator /= divisor;
 }
 
 
+// simplifies every rational in an array, same result as calling simplify() on each one
+// -
+// args:
+// rational *arr: array of rationals, simplified in-place
+// size_t n: number of rationals in arr
+// -
+// returns:
+// nothing
+// -
+// a single binary gcd is a chain of dependent shift/compare/subtract steps, so the cpu spends a lot of its time
+// waiting on the previous step. this runs 4 gcds in lockstep, each in its own registers, so the 4 chains
+// overlap in the pipeline. the loop runs until the slowest lane is done, finished lanes just idle
+void simplify_batch(rational *arr, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        unsigned int a0, a1, a2, a3, b0, b1, b2, b3;
+        int s0, s1, s2, s3, z0, z1, z2, z3;
+        gcd_lane_init(arr + i, &a0, &b0, &s0, &z0);
+        gcd_lane_init(arr + i + 1, &a1, &b1, &s1, &z1);
+        gcd_lane_init(arr + i + 2, &a2, &b2, &s2, &z2);
+        gcd_lane_init(arr + i + 3, &a3, &b3, &s3, &z3);
+        while ((a0 | a1 | a2 | a3) != 0) {
+            GCD_LANE_STEP(a0, b0, z0);
+            GCD_LANE_STEP(a1, b1, z1);
+            GCD_LANE_STEP(a2, b2, z2);
+            GCD_LANE_STEP(a3, b3, z3);
+        }
+        gcd_lane_finish(arr + i, b0, s0);
+        gcd_lane_finish(arr + i + 1, b1, s1);
+        gcd_lane_finish(arr + i + 2, b2, s2);
+        gcd_lane_finish(arr + i + 3, b3, s3);
+    }
+    for (; i < n; i++) simplify(arr + i);
+}
+
+
 // multiplies two rationals and stores the results in the third argument
 // - 
 // args:
@@ -177,12 +551,13 @@ void simplify(rational *r) {
 // rational *product: pointer to rational that stores product
 // -
 // returns:
-// nothing, results stored in *product
+// RATIONAL_OK, or RATIONAL_OVERFLOW/RATIONAL_ZERO_DENOMINATOR (see rational_multiply()), results stored in *product
 // -
-// uses rational_multiply() to multiply while avoiding and integer overflow errors (see line 105)
-void multiply(const rational *r1, const rational *r2, rational *product) {
-    rational_multiply(product, r1->numerator, r2->numerator, r1->denominator, r2->denominator);
-    simplify(product);
+// uses rational_multiply() to multiply exactly, so the result is only simplified here if the inputs weren't
+int multiply(const rational *r1, const rational *r2, rational *product) {
+    int status = rational_multiply(product, r1->numerator, r2->numerator, r1->denominator, r2->denominator);
+    if (status == RATIONAL_OK) simplify(product);
+    return status;
 }
 
 
@@ -194,17 +569,20 @@ void multiply(const rational *r1, const rational *r2, rational *product) {
 // rational *sum: pointer to rational that stores sum
 // -
 // returns:
-// nothing, results stored in *sum
+// RATIONAL_OK, or RATIONAL_OVERFLOW/RATIONAL_ZERO_DENOMINATOR (see rational_add()), results stored in *sum
 // -
-// uses rational_add() to add while avoiding and integer overflow errors (see line 59)
-void add(const rational *r1, const rational *r2, rational *sum) {
-    if (r1->denominator == r2->denominator) {
+// uses rational_add() to add exactly. rationals with the same denominator skip it and just add numerators
+int add(const rational *r1, const rational *r2, rational *sum) {
+    if (r1->denominator == r2->denominator && r1->denominator != 0) {
+        long long n = (long long) r1->numerator + r2->numerator;
+        if (n > INT_MAX || n < -INT_MAX) return RATIONAL_OVERFLOW;
         sum->denominator = r1->denominator;
-        sum->numerator = r1->numerator + r2->numerator;
-        return;
+        sum->numerator = (int) n;
+        return RATIONAL_OK;
     }
-    rational_add(sum, r1->numerator, r2->numerator, r1->denominator, r2->denominator);
-    simplify(sum);
+    int status = rational_add(sum, r1->numerator, r2->numerator, r1->denominator, r2->denominator);
+    if (status == RATIONAL_OK) simplify(sum);
+    return status;
 }
 
 
@@ -216,11 +594,10 @@ void add(const rational *r1, const rational *r2, rational *sum) {
 // rational *quotient: pointer to rational that stores quotient
 // -
 // returns:
-// nothing, results stored in *quotient
-void divide(const rational *r1, const rational *r2, rational *quotient) {
+// RATIONAL_OK, or RATIONAL_OVERFLOW/RATIONAL_ZERO_DENOMINATOR (dividing by 0), results stored in *quotient
+int divide(const rational *r1, const rational *r2, rational *quotient) {
     rational r2_flipped = {r2->denominator, r2->numerator};
-    multiply(r1, &r2_flipped, quotient);
-    simplify(quotient);
+    return multiply(r1, &r2_flipped, quotient);
 }
 
 
@@ -232,44 +609,1780 @@ void divide(const rational *r1, const rational *r2, rational *quotient) {
 // rational *difference: pointer to rational that stores difference
 // -
 // returns:
-// nothing, results stored in *difference
-void subtract(const rational *r1, const rational *r2, rational *difference) {
+// RATIONAL_OK, or RATIONAL_OVERFLOW/RATIONAL_ZERO_DENOMINATOR, results stored in *difference
+int subtract(const rational *r1, const rational *r2, rational *difference) {
     rational r2_minus = {-1 * r2->numerator, r2->denominator};
-    add(r1, &r2_minus, difference);
+    return add(r1, &r2_minus, difference);
 }
 
-int main(int argc, char *argv[]) {
-    // open file and read data into rational fractions[size]
-    FILE *f = fopen(argv[1], "r");
-    printf("\nfile: %s\n\n", argv[1]);
 
-    // first number is array size
-    int size;
-    fscanf(f, "%d", &size);
-    rational fractions[size];
+// struct bigint typedef to bigint
+// arbitrary precision integer used once a rational no longer fits in 64 bits. the magnitude is stored as base 2^32
+// limbs, least significant first
+typedef struct bigint {
+    unsigned int *limbs; // magnitude, least significant limb first
+    int len;             // number of limbs in use (0 means the value is 0)
+    int cap;             // number of limbs allocated
+    int negative;        // 1 if the value is < 0
+} bigint;
 
-    
-    // print rationals in fractions array and print out the sum/average
-    printf("rationals:\n[ \n");
-    read_file(f, &fractions);
-    rational r = {0, 1};
-    for (int i = 0; i < size; i++) {
-        print_rational(fractions + i);
-        if (i < size - 1) printf(", ");
-        simplify(fractions + i);
-        add(&((rational) {r.numerator, r.denominator}), fractions + i, &r);
-        if ((i+1) % FORMAT_COL == 0) printf("\n");
+
+// realloc() that gives up on the whole program if memory runs out, so the bigint code doesn't have to
+// thread an error code through every helper
+void* big_alloc(void *p, size_t size) {
+    p = realloc(p, size);
+    if (p == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
     }
-    printf("\n]\n\nsum:\n");
-    print_rational(&r);
+    return p;
+}
+
+
+// makes sure a has room for at least cap limbs
+void bi_reserve(bigint *a, int cap) {
+    if (a->cap < cap) {
+        a->limbs = big_alloc(a->limbs, cap * sizeof(unsigned int));
+        a->cap = cap;
+    }
+}
+
+
+// frees the limbs of a and resets it to 0
+void bi_free(bigint *a) {
+    free(a->limbs);
+    *a = (bigint) {0};
+}
+
+
+// swaps the contents of two bigints (used to move results into place without copying limbs)
+void bi_swap(bigint *a, bigint *b) {
+    bigint t = *a;
+    *a = *b;
+    *b = t;
+}
+
+
+// drops leading zero limbs so len is exact
+void bi_trim(bigint *a) {
+    while (a->len > 0 && a->limbs[a->len - 1] == 0) a->len--;
+    if (a->len == 0) a->negative = 0;
+}
+
+
+// a = v
+void bi_set64(bigint *a, long long v) {
+    unsigned long long m = (v < 0) ? -(unsigned long long) v : (unsigned long long) v;
+    bi_reserve(a, 2);
+    a->limbs[0] = (unsigned int) m;
+    a->limbs[1] = (unsigned int) (m >> 32);
+    a->len = 2;
+    a->negative = (v < 0);
+    bi_trim(a);
+}
+
+
+// dst = src
+void bi_copy(bigint *dst, const bigint *src) {
+    bi_reserve(dst, src->len);
+    for (int i = 0; i < src->len; i++) dst->limbs[i] = src->limbs[i];
+    dst->len = src->len;
+    dst->negative = src->negative;
+}
+
+
+// 1 if a fits in the 64 bit kernel's range (see RATIONAL64_MAX), 0 otherwise
+int bi_fits64(const bigint *a) {
+    return a->len < 2 || (a->len == 2 && a->limbs[1] < 0x80000000u);
+}
+
+
+// value of a, only valid if bi_fits64(a)
+long long bi_get64(const bigint *a) {
+    unsigned long long m = 0;
+    if (a->len > 0) m = a->limbs[0];
+    if (a->len > 1) m |= (unsigned long long) a->limbs[1] << 32;
+    return a->negative ? -(long long) m : (long long) m;
+}
+
+
+// compares magnitudes: -1 if |a| < |b|, 0 if equal, 1 if |a| > |b|
+int bi_cmp_mag(const bigint *a, const bigint *b) {
+    if (a->len != b->len) return (a->len < b->len) ? -1 : 1;
+    for (int i = a->len - 1; i >= 0; i--) {
+        if (a->limbs[i] != b->limbs[i]) return (a->limbs[i] < b->limbs[i]) ? -1 : 1;
+    }
+    return 0;
+}
+
+
+// |out| = |a| + |b|, out may be a or b
+void bi_add_mag(const bigint *a, const bigint *b, bigint *out) {
+    if (a->len < b->len) {
+        const bigint *t = a;
+        a = b;
+        b = t;
+    }
+    int alen = a->len, blen = b->len;
+    bi_reserve(out, alen + 1);
+    unsigned long long carry = 0;
+    for (int i = 0; i < alen; i++) {
+        carry += (unsigned long long) a->limbs[i] + ((i < blen) ? b->limbs[i] : 0);
+        out->limbs[i] = (unsigned int) carry;
+        carry >>= 32;
+    }
+    out->limbs[alen] = (unsigned int) carry;
+    out->len = alen + 1;
+    bi_trim(out);
+}
+
+
+// |out| = |a| - |b|, requires |a| >= |b|, out may be a or b
+void bi_sub_mag(const bigint *a, const bigint *b, bigint *out) {
+    int alen = a->len, blen = b->len;
+    bi_reserve(out, alen);
+    long long borrow = 0;
+    for (int i = 0; i < alen; i++) {
+        long long t = (long long) a->limbs[i] - ((i < blen) ? b->limbs[i] : 0) - borrow;
+        borrow = (t < 0);
+        out->limbs[i] = (unsigned int) t;
+    }
+    out->len = alen;
+    bi_trim(out);
+}
+
+
+// out = a + b (signed), out may be a or b
+void bi_add(const bigint *a, const bigint *b, bigint *out) {
+    int a_neg = a->negative, b_neg = b->negative;
+    if (a_neg == b_neg) {
+        bi_add_mag(a, b, out);
+        out->negative = (out->len > 0) ? a_neg : 0;
+    }
+    else if (bi_cmp_mag(a, b) >= 0) {
+        bi_sub_mag(a, b, out);
+        out->negative = (out->len > 0) ? a_neg : 0;
+    }
+    else {
+        bi_sub_mag(b, a, out);
+        out->negative = (out->len > 0) ? b_neg : 0;
+    }
+}
+
+
+// out = a * b (schoolbook), out may be a or b
+void bi_mul(const bigint *a, const bigint *b, bigint *out) {
+    bigint r = {0};
+    if (a->len == 0 || b->len == 0) {
+        bi_free(out);
+        return;
+    }
+    bi_reserve(&r, a->len + b->len);
+    for (int i = 0; i < a->len + b->len; i++) r.limbs[i] = 0;
+    for (int i = 0; i < a->len; i++) {
+        unsigned long long carry = 0;
+        for (int j = 0; j < b->len; j++) {
+            carry += (unsigned long long) a->limbs[i] * b->limbs[j] + r.limbs[i + j];
+            r.limbs[i + j] = (unsigned int) carry;
+            carry >>= 32;
+        }
+        r.limbs[i + b->len] = (unsigned int) carry;
+    }
+    r.len = a->len + b->len;
+    r.negative = a->negative != b->negative;
+    bi_trim(&r);
+    bi_swap(&r, out);
+    bi_free(&r);
+}
+
+
+// divides a by b, truncating towards 0 like / and % on ints
+// -
+// args:
+// const bigint *a: dividend
+// const bigint *b: divisor, must not be 0
+// bigint *q: stores the quotient (can be NULL)
+// bigint *r: stores the remainder, which has the sign of a (can be NULL)
+// -
+// this is Knuth's algorithm D (TAOCP vol. 2, 4.3.1): normalize so the top limb of the divisor has its high bit
+// set, estimate each quotient limb from the top two limbs of the remainder, then correct the estimate
+// (it's off by at most 2)
+void bi_divmod(const bigint *a, const bigint *b, bigint *q, bigint *r) {
+    bigint quot = {0}, rem = {0};
+    int n = b->len, m = a->len - b->len;
+
+    if (bi_cmp_mag(a, b) < 0) {
+        bi_copy(&rem, a);
+    }
+    else if (n == 1) {
+        unsigned long long d = b->limbs[0], k = 0;
+        bi_reserve(&quot, a->len);
+        for (int i = a->len - 1; i >= 0; i--) {
+            unsigned long long cur = (k << 32) | a->limbs[i];
+            quot.limbs[i] = (unsigned int) (cur / d);
+            k = cur % d;
+        }
+        quot.len = a->len;
+        bi_set64(&rem, (long long) k);
+    }
+    else {
+        int s = __builtin_clz(b->limbs[n - 1]);
+        unsigned int *vn = big_alloc(NULL, n * sizeof(unsigned int));
+        unsigned int *un = big_alloc(NULL, (a->len + 1) * sizeof(unsigned int));
+        for (int i = n - 1; i > 0; i--) {
+            vn[i] = (b->limbs[i] << s) | (s ? (unsigned int) ((unsigned long long) b->limbs[i - 1] >> (32 - s)) : 0);
+        }
+        vn[0] = b->limbs[0] << s;
+        un[a->len] = s ? (unsigned int) ((unsigned long long) a->limbs[a->len - 1] >> (32 - s)) : 0;
+        for (int i = a->len - 1; i > 0; i--) {
+            un[i] = (a->limbs[i] << s) | (s ? (unsigned int) ((unsigned long long) a->limbs[i - 1] >> (32 - s)) : 0);
+        }
+        un[0] = a->limbs[0] << s;
+
+        bi_reserve(&quot, m + 1);
+        for (int j = m; j >= 0; j--) {
+            unsigned long long num = ((unsigned long long) un[j + n] << 32) | un[j + n - 1];
+            unsigned long long qhat = num / vn[n - 1];
+            unsigned long long rhat = num % vn[n - 1];
+            while (qhat >> 32 || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+                qhat--;
+                rhat += vn[n - 1];
+                if (rhat >> 32) break;
+            }
+
+            // multiply and subtract qhat * vn from the current window of un
+            long long k = 0, t;
+            for (int i = 0; i < n; i++) {
+                unsigned long long p = qhat * vn[i];
+                t = (long long) un[i + j] - k - (long long) (p & 0xFFFFFFFFu);
+                un[i + j] = (unsigned int) t;
+                k = (long long) (p >> 32) - (t >> 32);
+            }
+            t = (long long) un[j + n] - k;
+            un[j + n] = (unsigned int) t;
+
+            // qhat was one too big, add the divisor back
+            if (t < 0) {
+                qhat--;
+                unsigned long long c = 0;
+                for (int i = 0; i < n; i++) {
+                    c += (unsigned long long) un[i + j] + vn[i];
+                    un[i + j] = (unsigned int) c;
+                    c >>= 32;
+                }
+                un[j + n] += (unsigned int) c;
+            }
+            quot.limbs[j] = (unsigned int) qhat;
+        }
+        quot.len = m + 1;
+
+        bi_reserve(&rem, n);
+        for (int i = 0; i < n - 1; i++) {
+            rem.limbs[i] = (un[i] >> s) | (s ? (unsigned int) ((unsigned long long) un[i + 1] << (32 - s)) : 0);
+        }
+        rem.limbs[n - 1] = un[n - 1] >> s;
+        rem.len = n;
+        free(vn);
+        free(un);
+    }
+
+    bi_trim(&quot);
+    if (quot.len > 0) quot.negative = a->negative != b->negative;
+    bi_trim(&rem);
+    if (rem.len > 0) rem.negative = a->negative;
+    if (q != NULL) bi_swap(&quot, q);
+    if (r != NULL) bi_swap(&rem, r);
+    bi_free(&quot);
+    bi_free(&rem);
+}
+
+
+// out = gcd(|a|, |b|) using the Euclidean algorithm on top of bi_divmod()
+void bi_gcd(const bigint *a, const bigint *b, bigint *out) {
+    bigint x = {0}, y = {0}, t = {0};
+    bi_copy(&x, a);
+    bi_copy(&y, b);
+    x.negative = y.negative = 0;
+    while (y.len > 0) {
+        // once both fit in 64 bits finish with the (much cheaper) 64 bit gcd
+        if (bi_fits64(&x) && bi_fits64(&y)) {
+            bi_set64(&x, gcd64(bi_get64(&x), bi_get64(&y)));
+            break;
+        }
+        bi_divmod(&x, &y, NULL, &t);
+        bi_swap(&x, &y);
+        bi_swap(&y, &t);
+    }
+    bi_swap(&x, out);
+    bi_free(&x);
+    bi_free(&y);
+    bi_free(&t);
+}
+
+
+// prints a in decimal by repeatedly dividing by 10^9 and printing the 9 digit chunks most significant first
+void bi_print(const bigint *a) {
+    if (a->len == 0) {
+        printf("0");
+        return;
+    }
+    bigint t = {0};
+    bi_copy(&t, a);
+    unsigned int *chunks = big_alloc(NULL, (t.len * 10 / 9 + 2) * sizeof(unsigned int));
+    int count = 0;
+    do {
+        unsigned long long k = 0;
+        for (int i = t.len - 1; i >= 0; i--) {
+            unsigned long long cur = (k << 32) | t.limbs[i];
+            t.limbs[i] = (unsigned int) (cur / 1000000000u);
+            k = cur % 1000000000u;
+        }
+        chunks[count++] = (unsigned int) k;
+        bi_trim(&t);
+    } while (t.len > 0);
+    printf("%s%u", a->negative ? "-" : "", chunks[count - 1]);
+    for (int i = count - 2; i >= 0; i--) printf("%09u", chunks[i]);
+    free(chunks);
+    bi_free(&t);
+}
+
+
+// struct big_rational typedef to big_rational
+// exact rational with no size limit. while numerator and denominator fit in 64 bits the value lives inline in
+// numerator/denominator and all arithmetic goes through the 64 bit kernel (rational64_add() etc). when that
+// kernel reports RATIONAL_OVERFLOW the value is promoted to bigint limbs, and it's demoted again as soon as
+// a result fits. always stored in lowest terms with a positive denominator
+typedef struct big_rational {
+    long long numerator;   // the value while is_big == 0
+    long long denominator;
+    int is_big;            // 1 when the value lives in num/den instead
+    bigint num;
+    bigint den;
+} big_rational;
+
+// makes a big_rational on the inline fast path, e.g. big_rational r = BIG_RATIONAL(0, 1);
+#define BIG_RATIONAL(n, d) ((big_rational) {(n), (d), 0, {0}, {0}})
+
+
+// frees the limbs of a big_rational (needed once it might have been promoted)
+void big_free(big_rational *r) {
+    bi_free(&r->num);
+    bi_free(&r->den);
+    *r = BIG_RATIONAL(0, 1);
+}
+
+
+// copies the value of r into bigints n and d whether or not r has been promoted
+void big_promote(const big_rational *r, bigint *n, bigint *d) {
+    if (r->is_big) {
+        bi_copy(n, &r->num);
+        bi_copy(d, &r->den);
+    }
+    else {
+        bi_set64(n, r->numerator);
+        bi_set64(d, r->denominator);
+    }
+}
+
+
+// stores n/d (already in lowest terms) in *r, demoting to the inline representation if it fits. n and d are
+// swapped into *r rather than copied, so the caller just frees whatever they hold afterwards
+void big_store(big_rational *r, bigint *n, bigint *d) {
+    if (d->negative) {
+        d->negative = 0;
+        n->negative = (n->len > 0) ? !n->negative : 0;
+    }
+    if (n->len == 0) bi_set64(d, 1);
+    if (bi_fits64(n) && bi_fits64(d)) {
+        r->numerator = bi_get64(n);
+        r->denominator = bi_get64(d);
+        r->is_big = 0;
+        return;
+    }
+    bi_swap(&r->num, n);
+    bi_swap(&r->den, d);
+    r->is_big = 1;
+}
+
+
+// 1 if r has a denominator of 0 (only possible on the inline representation, promoted values are normalized)
+#define BIG_ZERO_DENOMINATOR(r) (!(r)->is_big && (r)->denominator == 0)
+
+
+// adds two big_rationals and stores the results in the third argument (same call shape as add())
+// -
+// args:
+// const big_rational *r1: first addend
+// const big_rational *r2: second addend
+// big_rational *sum: pointer to big_rational that stores sum (may be r1 or r2)
+// -
+// returns:
+// RATIONAL_OK or RATIONAL_ZERO_DENOMINATOR, results stored in *sum
+// -
+// stays on rational64_add() while both operands are inline and the result fits, otherwise does the same
+// gcd(den1, den2) trick with bigints. all the gcds and divisions involve g = gcd(den1, den2), which is small
+// whenever one operand is, so adding a small fraction into a huge running sum is linear in its number of limbs
+int big_add(const big_rational *r1, const big_rational *r2, big_rational *sum) {
+    if (BIG_ZERO_DENOMINATOR(r1) || BIG_ZERO_DENOMINATOR(r2)) return RATIONAL_ZERO_DENOMINATOR;
+    if (!r1->is_big && !r2->is_big) {
+        long long n, d;
+        if (rational64_add(r1->numerator, r1->denominator, r2->numerator, r2->denominator, &n, &d) == RATIONAL_OK) {
+            sum->numerator = n;
+            sum->denominator = d;
+            sum->is_big = 0;
+            return RATIONAL_OK;
+        }
+    }
+    bigint n1 = {0}, d1 = {0}, n2 = {0}, d2 = {0}, g = {0}, g2 = {0};
+    big_promote(r1, &n1, &d1);
+    big_promote(r2, &n2, &d2);
+    bi_gcd(&d1, &d2, &g);
+    bi_divmod(&d1, &g, &d1, NULL);
+    bi_divmod(&d2, &g, &d2, NULL);
+    bi_mul(&n1, &d2, &n1);
+    bi_mul(&n2, &d1, &n2);
+    bi_add(&n1, &n2, &n1);
+    bi_gcd(&n1, &g, &g2);
+    if (g2.len > 0) {
+        bi_divmod(&n1, &g2, &n1, NULL);
+        bi_divmod(&g, &g2, &g, NULL);
+    }
+    bi_mul(&d1, &d2, &d1);
+    bi_mul(&d1, &g, &d1);
+    big_store(sum, &n1, &d1);
+    bi_free(&n1);
+    bi_free(&d1);
+    bi_free(&n2);
+    bi_free(&d2);
+    bi_free(&g);
+    bi_free(&g2);
+    return RATIONAL_OK;
+}
+
+
+// multiplies two big_rationals and stores the results in the third argument (same call shape as multiply())
+// -
+// args:
+// const big_rational *r1: first multiplier
+// const big_rational *r2: second multiplier
+// big_rational *product: pointer to big_rational that stores product (may be r1 or r2)
+// -
+// returns:
+// RATIONAL_OK or RATIONAL_ZERO_DENOMINATOR, results stored in *product
+// -
+// like rational64_multiply() this cross-reduces by gcd(n1, d2) and gcd(n2, d1) before multiplying
+int big_multiply(const big_rational *r1, const big_rational *r2, big_rational *product) {
+    if (BIG_ZERO_DENOMINATOR(r1) || BIG_ZERO_DENOMINATOR(r2)) return RATIONAL_ZERO_DENOMINATOR;
+    if (!r1->is_big && !r2->is_big) {
+        long long n, d;
+        if (rational64_multiply(r1->numerator, r1->denominator, r2->numerator, r2->denominator, &n, &d) == RATIONAL_OK) {
+            product->numerator = n;
+            product->denominator = d;
+            product->is_big = 0;
+            return RATIONAL_OK;
+        }
+    }
+    bigint n1 = {0}, d1 = {0}, n2 = {0}, d2 = {0}, g = {0};
+    big_promote(r1, &n1, &d1);
+    big_promote(r2, &n2, &d2);
+    bi_gcd(&n1, &d2, &g);
+    if (g.len > 0) {
+        bi_divmod(&n1, &g, &n1, NULL);
+        bi_divmod(&d2, &g, &d2, NULL);
+    }
+    bi_gcd(&n2, &d1, &g);
+    if (g.len > 0) {
+        bi_divmod(&n2, &g, &n2, NULL);
+        bi_divmod(&d1, &g, &d1, NULL);
+    }
+    bi_mul(&n1, &n2, &n1);
+    bi_mul(&d1, &d2, &d1);
+    big_store(product, &n1, &d1);
+    bi_free(&n1);
+    bi_free(&d1);
+    bi_free(&n2);
+    bi_free(&d2);
+    bi_free(&g);
+    return RATIONAL_OK;
+}
+
+
+// subtracts two big_rationals and stores the results in the third argument (same call shape as subtract())
+// -
+// returns:
+// RATIONAL_OK or RATIONAL_ZERO_DENOMINATOR, results stored in *difference
+int big_subtract(const big_rational *r1, const big_rational *r2, big_rational *difference) {
+    // shallow copy - the limbs are shared but only read
+    big_rational r2_minus = *r2;
+    r2_minus.numerator = -r2_minus.numerator;
+    r2_minus.num.negative = (r2_minus.num.len > 0) ? !r2_minus.num.negative : 0;
+    return big_add(r1, &r2_minus, difference);
+}
+
+
+// divides two big_rationals and stores the results in the third argument (same call shape as divide())
+// -
+// returns:
+// RATIONAL_OK or RATIONAL_ZERO_DENOMINATOR (dividing by 0), results stored in *quotient
+int big_divide(const big_rational *r1, const big_rational *r2, big_rational *quotient) {
+    // shallow copy - the limbs are shared but only read
+    big_rational r2_flipped = *r2;
+    r2_flipped.numerator = r2->denominator;
+    r2_flipped.denominator = r2->numerator;
+    r2_flipped.num = r2->den;
+    r2_flipped.den = r2->num;
+    if (r2->is_big && r2->num.negative) {
+        r2_flipped.num.negative = 1;
+        r2_flipped.den.negative = 0;
+    }
+    return big_multiply(r1, &r2_flipped, quotient);
+}
+
+
+// prints a big_rational as numerator/denominator
+void big_print(const big_rational *r) {
+    if (!r->is_big) {
+        printf("%lld/%lld", r->numerator, r->denominator);
+        return;
+    }
+    bi_print(&r->num);
+    printf("/");
+    bi_print(&r->den);
+}
+
+
+// struct rational_batch typedef to rational_batch
+// structure-of-arrays version of rational[] for elementwise work over lots of pairs: numerators and denominators
+// live in separate arrays so the batch_* kernels below can load 4 of each at a time. values are stored as long
+// long so a kernel's unreduced result (products of two ints) always fits, batch_normalize() brings them back
+// to lowest terms afterwards. the kernels expect normalized inputs (every value fits in an int, see
+// batch_normalize()) and don't simplify anything themselves
+typedef struct rational_batch {
+    long long *numerators;
+    long long *denominators;
+    size_t n;
+} rational_batch;
+
+
+// allocates room for n rationals in b
+// -
+// returns:
+// 0 on success, -1 if malloc failed
+int batch_init(rational_batch *b, size_t n) {
+    b->numerators = malloc((n > 0 ? n : 1) * sizeof(long long));
+    b->denominators = malloc((n > 0 ? n : 1) * sizeof(long long));
+    b->n = n;
+    if (b->numerators == NULL || b->denominators == NULL) {
+        free(b->numerators);
+        free(b->denominators);
+        *b = (rational_batch) {0};
+        return -1;
+    }
+    return 0;
+}
+
+
+// frees the arrays of a rational_batch
+void batch_free(rational_batch *b) {
+    free(b->numerators);
+    free(b->denominators);
+    *b = (rational_batch) {0};
+}
+
+
+// copies b->n rationals from an array of structs into a batch
+void batch_from_array(rational_batch *b, const rational *arr) {
+    for (size_t i = 0; i < b->n; i++) {
+        b->numerators[i] = arr[i].numerator;
+        b->denominators[i] = arr[i].denominator;
+    }
+}
+
+
+// copies a (normalized) batch back into an array of structs
+void batch_to_array(const rational_batch *b, rational *arr) {
+    for (size_t i = 0; i < b->n; i++) {
+        arr[i].numerator = (int) b->numerators[i];
+        arr[i].denominator = (int) b->denominators[i];
+    }
+}
+
+
+// widening multiply of the low 32 bits of two long longs, the scalar version of _mm256_mul_epi32
+#define MUL32(x, y) ((long long) (int) (x) * (int) (y))
+
+
+// out[i] = a[i] * b[i] for every i < out->n, without simplifying
+// -
+// args:
+// const rational_batch *a, *b: normalized multipliers (at least out->n elements each)
+// rational_batch *out: stores the products (may be a or b)
+// -
+// returns:
+// nothing
+// -
+// with AVX2 (build with -mavx2 or -march=native) 4 pairs are done per iteration with _mm256_mul_epi32, which
+// multiplies the low 32 bits of each 64 bit lane into a full 64 bit product (2 pairs with _mm_mul_epi32 on
+// SSE4.1). compilers won't generate that from plain C since they can't know the high halves are just sign
+// bits. the scalar loop handles the rest
+void batch_multiply(const rational_batch *a, const rational_batch *b, rational_batch *out) {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 4 <= out->n; i += 4) {
+        __m256i an = _mm256_loadu_si256((const __m256i *) (a->numerators + i));
+        __m256i ad = _mm256_loadu_si256((const __m256i *) (a->denominators + i));
+        __m256i bn = _mm256_loadu_si256((const __m256i *) (b->numerators + i));
+        __m256i bd = _mm256_loadu_si256((const __m256i *) (b->denominators + i));
+        _mm256_storeu_si256((__m256i *) (out->numerators + i), _mm256_mul_epi32(an, bn));
+        _mm256_storeu_si256((__m256i *) (out->denominators + i), _mm256_mul_epi32(ad, bd));
+    }
+#elif defined(__SSE4_1__)
+    for (; i + 2 <= out->n; i += 2) {
+        __m128i an = _mm_loadu_si128((const __m128i *) (a->numerators + i));
+        __m128i ad = _mm_loadu_si128((const __m128i *) (a->denominators + i));
+        __m128i bn = _mm_loadu_si128((const __m128i *) (b->numerators + i));
+        __m128i bd = _mm_loadu_si128((const __m128i *) (b->denominators + i));
+        _mm_storeu_si128((__m128i *) (out->numerators + i), _mm_mul_epi32(an, bn));
+        _mm_storeu_si128((__m128i *) (out->denominators + i), _mm_mul_epi32(ad, bd));
+    }
+#endif
+    for (; i < out->n; i++) {
+        long long n = MUL32(a->numerators[i], b->numerators[i]);
+        long long d = MUL32(a->denominators[i], b->denominators[i]);
+        out->numerators[i] = n;
+        out->denominators[i] = d;
+    }
+}
+
+
+// out[i] = a[i] + b[i] for every i < out->n, without simplifying (n1 * d2 + n2 * d1 over d1 * d2)
+// -
+// args:
+// const rational_batch *a, *b: normalized addends (at least out->n elements each)
+// rational_batch *out: stores the sums (may be a or b)
+// -
+// returns:
+// nothing
+// -
+// |n1 * d2| and |n2 * d1| are both below 2^62 for int inputs, so the sum can't overflow a long long.
+// same AVX2/SSE4.1 paths as batch_multiply()
+void batch_add(const rational_batch *a, const rational_batch *b, rational_batch *out) {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 4 <= out->n; i += 4) {
+        __m256i an = _mm256_loadu_si256((const __m256i *) (a->numerators + i));
+        __m256i ad = _mm256_loadu_si256((const __m256i *) (a->denominators + i));
+        __m256i bn = _mm256_loadu_si256((const __m256i *) (b->numerators + i));
+        __m256i bd = _mm256_loadu_si256((const __m256i *) (b->denominators + i));
+        __m256i n = _mm256_add_epi64(_mm256_mul_epi32(an, bd), _mm256_mul_epi32(bn, ad));
+        _mm256_storeu_si256((__m256i *) (out->numerators + i), n);
+        _mm256_storeu_si256((__m256i *) (out->denominators + i), _mm256_mul_epi32(ad, bd));
+    }
+#elif defined(__SSE4_1__)
+    for (; i + 2 <= out->n; i += 2) {
+        __m128i an = _mm_loadu_si128((const __m128i *) (a->numerators + i));
+        __m128i ad = _mm_loadu_si128((const __m128i *) (a->denominators + i));
+        __m128i bn = _mm_loadu_si128((const __m128i *) (b->numerators + i));
+        __m128i bd = _mm_loadu_si128((const __m128i *) (b->denominators + i));
+        __m128i n = _mm_add_epi64(_mm_mul_epi32(an, bd), _mm_mul_epi32(bn, ad));
+        _mm_storeu_si128((__m128i *) (out->numerators + i), n);
+        _mm_storeu_si128((__m128i *) (out->denominators + i), _mm_mul_epi32(ad, bd));
+    }
+#endif
+    for (; i < out->n; i++) {
+        long long n = MUL32(a->numerators[i], b->denominators[i]) + MUL32(b->numerators[i], a->denominators[i]);
+        long long d = MUL32(a->denominators[i], b->denominators[i]);
+        out->numerators[i] = n;
+        out->denominators[i] = d;
+    }
+}
+
+
+// out[i] = 1 / a[i] for every i < out->n, keeping denominators positive (a zero numerator gives a zero denominator)
+// -
+// args:
+// const rational_batch *a: rationals to flip (at least out->n elements)
+// rational_batch *out: stores the reciprocals (may be a)
+// -
+// returns:
+// nothing
+// -
+// this is just a swap plus a branchless sign fix, which compilers vectorize on their own
+void batch_reciprocal(const rational_batch *a, rational_batch *out) {
+    for (size_t i = 0; i < out->n; i++) {
+        long long n = a->denominators[i];
+        long long d = a->numerators[i];
+        long long sign = (d < 0) ? -1 : 1;
+        out->numerators[i] = n * sign;
+        out->denominators[i] = d * sign;
+    }
+}
+
+
+// deferred normalization pass for the batch_* kernels: reduces every rational in b to lowest terms with a
+// positive denominator
+// -
+// args:
+// rational_batch *b: batch normalized in-place
+// -
+// returns:
+// number of rationals that still aren't valid kernel inputs afterwards, because a value doesn't fit in an int
+// or the denominator is 0. 0 means the whole batch can go through the kernels (or batch_to_array()) again
+size_t batch_normalize(rational_batch *b) {
+    size_t bad = 0;
+    for (size_t i = 0; i < b->n; i++) {
+        long long n = b->numerators[i], d = b->denominators[i];
+        long long g = gcd64(n, d);
+        if (d < 0) g = -g;
+        if (g != 0) {
+            n /= g;
+            d /= g;
+        }
+        b->numerators[i] = n;
+        b->denominators[i] = d;
+        bad += (d == 0 || n > INT_MAX || n < -INT_MAX || d > INT_MAX);
+    }
+    return bad;
+}
+
+
+// seconds since some fixed point, for timing the benchmarks
+double now_seconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+// micro-benchmark for the gcd implementations: simplifies n random rationals with the old Euclidean gcd_euclid(),
+// with simplify() (binary gcd) and with simplify_batch(), and prints simplifications/sec for each
+// -
+// args:
+// int n: number of rationals to simplify
+// -
+// returns:
+// 0 if all three produced the same results, 1 otherwise
+int gcd_benchmark(int n) {
+    rational *input = malloc(n * sizeof(rational));
+    rational *work = malloc(n * sizeof(rational));
+    rational *expected = malloc(n * sizeof(rational));
+    if (input == NULL || work == NULL || expected == NULL) {
+        fprintf(stderr, "could not allocate %d rationals\n", n);
+        free(input);
+        free(work);
+        free(expected);
+        return 1;
+    }
+    // random values with a random common factor so the gcds aren't almost always 1
+    srand(12345);
+    for (int i = 0; i < n; i++) {
+        int common = rand() % 1000 + 1;
+        input[i].numerator = (rand() % 2000000 - 1000000) * common;
+        input[i].denominator = (rand() % 1000000 + 1) * common;
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < n; i++) {
+        int divisor = gcd_euclid(input[i].numerator, input[i].denominator);
+        expected[i].numerator = input[i].numerator / divisor;
+        expected[i].denominator = input[i].denominator / divisor;
+    }
+    double euclid = now_seconds() - start;
+
+    memcpy(work, input, n * sizeof(rational));
+    start = now_seconds();
+    for (int i = 0; i < n; i++) simplify(work + i);
+    double binary = now_seconds() - start;
+    int mismatch = memcmp(work, expected, n * sizeof(rational)) != 0;
+
+    memcpy(work, input, n * sizeof(rational));
+    start = now_seconds();
+    simplify_batch(work, n);
+    double batch = now_seconds() - start;
+    mismatch |= memcmp(work, expected, n * sizeof(rational)) != 0;
+
+    printf("\nsimplifying %d rationals:\n", n);
+    printf("euclidean gcd:   %12.0f simplifications/sec\n", n / euclid);
+    printf("binary gcd:      %12.0f simplifications/sec\n", n / binary);
+    printf("simplify_batch:  %12.0f simplifications/sec\n", n / batch);
+    printf("results %s\n\n", mismatch ? "DON'T match" : "match");
+
+    free(input);
+    free(work);
+    free(expected);
+    return mismatch;
+}
+
+
+// checks the rational_batch kernels against the scalar add()/multiply()/divide() on n random pairs of
+// rationals and prints operations/sec for both
+// -
+// args:
+// int n: number of pairs
+// -
+// returns:
+// 0 if every batch result matched the scalar one, 1 otherwise
+// -
+// values are kept below 30000 so every scalar result fits in an int and the two sides can be compared 1:1
+int batch_benchmark(int n) {
+    rational *a = malloc(n * sizeof(rational));
+    rational *b = malloc(n * sizeof(rational));
+    rational *expected = malloc(3 * (size_t) n * sizeof(rational));
+    rational *got = malloc(n * sizeof(rational));
+    rational_batch ba, bb, out;
+    // a failed batch_init() leaves its batch zeroed, so batch_free() is safe on all three either way
+    int ok = a != NULL && b != NULL && expected != NULL && got != NULL;
+    ok &= batch_init(&ba, n) == 0;
+    ok &= batch_init(&bb, n) == 0;
+    ok &= batch_init(&out, n) == 0;
+    if (!ok) {
+        fprintf(stderr, "could not allocate %d rational pairs\n", n);
+        batch_free(&ba);
+        batch_free(&bb);
+        batch_free(&out);
+        free(a);
+        free(b);
+        free(expected);
+        free(got);
+        return 1;
+    }
+    // b's numerators are never 0 so divide() always has something to divide by
+    srand(54321);
+    for (int i = 0; i < n; i++) {
+        a[i] = (rational) {rand() % 60000 - 30000, rand() % 30000 + 1};
+        b[i] = (rational) {rand() % 30000 + 1, rand() % 30000 + 1};
+        if (rand() % 2) b[i].numerator = -b[i].numerator;
+        simplify(a + i);
+        simplify(b + i);
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < n; i++) {
+        add(a + i, b + i, expected + i);
+        multiply(a + i, b + i, expected + n + i);
+        divide(a + i, b + i, expected + 2 * (size_t) n + i);
+    }
+    double scalar = now_seconds() - start;
+    // add()'s equal denominator shortcut doesn't reduce, batch_normalize() always does
+    for (int i = 0; i < n; i++) simplify(expected + i);
+
+    // converting in and out is part of what a caller pays, so it's timed too
+    int mismatch = 0;
+    double batch = 0;
+    for (int op = 0; op < 3; op++) {
+        start = now_seconds();
+        batch_from_array(&ba, a);
+        batch_from_array(&bb, b);
+        if (op == 0) batch_add(&ba, &bb, &out);
+        else if (op == 1) batch_multiply(&ba, &bb, &out);
+        else {
+            batch_reciprocal(&bb, &bb);
+            batch_multiply(&ba, &bb, &out);
+        }
+        mismatch |= batch_normalize(&out) != 0;
+        batch_to_array(&out, got);
+        batch += now_seconds() - start;
+        mismatch |= memcmp(got, expected + op * (size_t) n, n * sizeof(rational)) != 0;
+    }
+
+    printf("adding, multiplying and dividing %d pairs of rationals:\n", n);
+    printf("scalar:          %12.0f operations/sec\n", 3.0 * n / scalar);
+    printf("rational_batch:  %12.0f operations/sec\n", 3.0 * n / batch);
+    printf("results %s\n\n", mismatch ? "DON'T match" : "match");
+
+    batch_free(&ba);
+    batch_free(&bb);
+    batch_free(&out);
+    free(a);
+    free(b);
+    free(expected);
+    free(got);
+    return mismatch;
+}
+
+
+// struct den_bucket typedef to den_bucket
+// one slot of a bucket_sum hash table: the running numerator total of every fraction with this denominator
+typedef struct den_bucket {
+    int denominator;    // 0 means the slot is empty
+    long long numerator;
+} den_bucket;
+
+// struct bucket_sum typedef to bucket_sum
+// accumulator that exploits the equal-denominator shortcut in add(): fractions are hashed by denominator and
+// their numerators summed with plain integer adds, so only one big_add() per distinct denominator is needed
+// when the total is read with bucket_sum_finish()
+typedef struct bucket_sum {
+    den_bucket *buckets; // open addressing table, linear probing
+    size_t cap;          // number of slots (a power of 2)
+    size_t used;         // number of occupied slots
+    big_rational spill;  // buckets whose numerator total would have overflowed are flushed in here early
+    int status;          // RATIONAL_OK, or the first error seen
+} bucket_sum;
+
+// starting number of slots in a bucket_sum, the table doubles whenever it gets half full
+#define BUCKET_INIT_CAP 64
+
+
+// sets up an empty bucket_sum
+void bucket_sum_init(bucket_sum *b) {
+    b->buckets = big_alloc(NULL, BUCKET_INIT_CAP * sizeof(den_bucket));
+    for (size_t i = 0; i < BUCKET_INIT_CAP; i++) b->buckets[i].denominator = 0;
+    b->cap = BUCKET_INIT_CAP;
+    b->used = 0;
+    b->spill = BIG_RATIONAL(0, 1);
+    b->status = RATIONAL_OK;
+}
+
+
+// finds the slot for denominator d (either the one holding it or the empty one where it belongs)
+den_bucket* bucket_find(den_bucket *buckets, size_t cap, int d) {
+    // multiplicative (fibonacci) hash so denominators that are multiples of each other spread out
+    size_t i = (size_t) (((unsigned int) d * 2654435769u) >> 7) & (cap - 1);
+    while (buckets[i].denominator != 0 && buckets[i].denominator != d) i = (i + 1) & (cap - 1);
+    return buckets + i;
+}
+
+
+// doubles the table and rehashes every occupied slot into it
+void bucket_grow(bucket_sum *b) {
+    size_t cap = b->cap * 2;
+    den_bucket *buckets = big_alloc(NULL, cap * sizeof(den_bucket));
+    for (size_t i = 0; i < cap; i++) buckets[i].denominator = 0;
+    for (size_t i = 0; i < b->cap; i++) {
+        if (b->buckets[i].denominator != 0) *bucket_find(buckets, cap, b->buckets[i].denominator) = b->buckets[i];
+    }
+    free(b->buckets);
+    b->buckets = buckets;
+    b->cap = cap;
+}
+
+
+// adds n/d into b->spill, reducing it first since big_add() expects its operands in lowest terms
+void bucket_spill(bucket_sum *b, long long n, long long d) {
+    long long g = gcd64(n, d);
+    b->status = big_add(&b->spill, &BIG_RATIONAL(n / g, d / g), &b->spill);
+}
+
+
+// adds numerator/denominator into the bucket for its denominator
+// -
+// args:
+// bucket_sum *b: accumulator
+// int numerator, int denominator: fraction to add (doesn't have to be simplified)
+// -
+// returns:
+// nothing, errors (a zero denominator) are kept in b->status and everything after them is ignored
+void bucket_sum_add(bucket_sum *b, int numerator, int denominator) {
+    if (b->status != RATIONAL_OK) return;
+    if (denominator == 0) {
+        b->status = RATIONAL_ZERO_DENOMINATOR;
+        return;
+    }
+    // keep denominators positive so n/d and -n/-d land in the same bucket
+    long long n = numerator, d = denominator;
+    if (d < 0) {
+        n = -n;
+        d = -d;
+    }
+    // -INT_MIN doesn't fit in an int, send that one straight to the spill sum
+    if (d > INT_MAX) {
+        bucket_spill(b, n, d);
+        return;
+    }
+    den_bucket *slot = bucket_find(b->buckets, b->cap, (int) d);
+    if (slot->denominator == 0) {
+        slot->denominator = (int) d;
+        slot->numerator = 0;
+        b->used++;
+    }
+    long long total;
+    if (__builtin_add_overflow(slot->numerator, n, &total)) {
+        bucket_spill(b, slot->numerator, d);
+        total = n;
+    }
+    slot->numerator = total;
+    if (b->used * 2 > b->cap) bucket_grow(b);
+}
+
+
+// adds every bucket into *sum and frees the bucket_sum
+// -
+// args:
+// bucket_sum *b: accumulator
+// big_rational *sum: pointer to big_rational the bucket totals are added into
+// -
+// returns:
+// RATIONAL_OK, or the first error seen while accumulating
+int bucket_sum_finish(bucket_sum *b, big_rational *sum) {
+    int status = b->status;
+    for (size_t i = 0; i < b->cap && status == RATIONAL_OK; i++) {
+        den_bucket *slot = b->buckets + i;
+        if (slot->denominator == 0 || slot->numerator == 0) continue;
+        bucket_spill(b, slot->numerator, slot->denominator);
+        status = b->status;
+    }
+    if (status == RATIONAL_OK) status = big_add(sum, &b->spill, sum);
+    free(b->buckets);
+    big_free(&b->spill);
+    return status;
+}
+
+
+// struct lazy_rational typedef to lazy_rational
+// accumulator that skips the per-operation gcd: the value is kept unreduced in 128 bits together with upper
+// bounds on the bit lengths of its numerator and denominator. a gcd reduction only happens when the next
+// operation could overflow 128 bits, or when the value is read with lazy_read(). if even the reduced value is
+// too big it's moved into an exact big_rational (spill) and the 128 bit part starts over from 0
+typedef struct lazy_rational {
+    __int128 numerator;   // not necessarily in lowest terms
+    __int128 denominator; // always > 0
+    int num_bits;         // upper bounds on the bit lengths of |numerator| and denominator
+    int den_bits;
+    big_rational spill;   // the value is spill + numerator/denominator
+    long long reductions; // number of gcd reductions done so far
+} lazy_rational;
+
+// largest bit length the 128 bit part may reach. keeping both products of an add under 2^126 means their sum
+// still fits in a signed __int128
+#define LAZY_BITS 126
+
+
+// bit length of |v| (0 for 0)
+int bits128(__int128 v) {
+    unsigned __int128 m = (v < 0) ? -(unsigned __int128) v : (unsigned __int128) v;
+    unsigned long long hi = (unsigned long long) (m >> 64);
+    if (hi != 0) return 128 - __builtin_clzll(hi);
+    return (m != 0) ? 64 - __builtin_clzll((unsigned long long) m) : 0;
+}
+
+
+// sets up a lazy_rational holding 0
+void lazy_init(lazy_rational *l) {
+    l->numerator = 0;
+    l->denominator = 1;
+    l->num_bits = 0;
+    l->den_bits = 1;
+    l->spill = BIG_RATIONAL(0, 1);
+    l->reductions = 0;
+}
+
+
+// frees the spill of a lazy_rational
+void lazy_free(lazy_rational *l) {
+    big_free(&l->spill);
+}
+
+
+// reduces the 128 bit part to lowest terms and makes the bit lengths exact
+void lazy_reduce(lazy_rational *l) {
+    unsigned __int128 g = gcd128((l->numerator < 0) ? -(unsigned __int128) l->numerator : (unsigned __int128) l->numerator,
+                                 (unsigned __int128) l->denominator);
+    l->numerator /= (__int128) g;
+    l->denominator /= (__int128) g;
+    l->num_bits = bits128(l->numerator);
+    l->den_bits = bits128(l->denominator);
+    l->reductions++;
+}
+
+
+// sets b = v for a 128 bit value
+void bi_set128(bigint *b, __int128 v) {
+    unsigned __int128 m = (v < 0) ? -(unsigned __int128) v : (unsigned __int128) v;
+    bi_reserve(b, 4);
+    for (int i = 0; i < 4; i++) b->limbs[i] = (unsigned int) (m >> (32 * i));
+    b->len = 4;
+    b->negative = (v < 0);
+    bi_trim(b);
+}
+
+
+// moves the (reduced) 128 bit part into the spill and resets it to 0
+// -
+// returns:
+// RATIONAL_OK (big_add() can't fail here since both denominators are positive)
+int lazy_flush(lazy_rational *l) {
+    big_rational part = BIG_RATIONAL(0, 1);
+    bigint n = {0}, d = {0};
+    bi_set128(&n, l->numerator);
+    bi_set128(&d, l->denominator);
+    big_store(&part, &n, &d);
+    int status = big_add(&l->spill, &part, &l->spill);
+    bi_free(&n);
+    bi_free(&d);
+    big_free(&part);
+    l->numerator = 0;
+    l->denominator = 1;
+    l->num_bits = 0;
+    l->den_bits = 1;
+    return status;
+}
+
+
+// adds n/d into a lazy_rational
+// -
+// args:
+// lazy_rational *l: accumulator
+// long long n, long long d: fraction to add, |n| and |d| at most RATIONAL64_MAX (doesn't have to be simplified)
+// -
+// returns:
+// RATIONAL_OK or RATIONAL_ZERO_DENOMINATOR
+// -
+// equal denominators just add numerators (like add() does). otherwise the usual cross multiplication is done
+// in 128 bits, after a reduction (and if needed a flush into the spill) when the bit length bounds say it
+// could overflow
+int lazy_add(lazy_rational *l, long long n, long long d) {
+    if (d == 0) return RATIONAL_ZERO_DENOMINATOR;
+    if (d < 0) {
+        n = -n;
+        d = -d;
+    }
+    int nb = bits128(n), db = bits128(d);
+    if (l->denominator == d) {
+        if ((l->num_bits > nb ? l->num_bits : nb) + 1 > LAZY_BITS) lazy_reduce(l);
+        if (l->denominator == d && (l->num_bits > nb ? l->num_bits : nb) + 1 <= LAZY_BITS) {
+            l->numerator += n;
+            l->num_bits = (l->num_bits > nb ? l->num_bits : nb) + 1;
+            return RATIONAL_OK;
+        }
+    }
+    for (int attempt = 0; ; attempt++) {
+        int left = l->num_bits + db, right = nb + l->den_bits;
+        if ((left > right ? left : right) + 1 <= LAZY_BITS && l->den_bits + db <= LAZY_BITS) break;
+        if (attempt == 0) lazy_reduce(l);
+        else lazy_flush(l);
+    }
+    int left = l->num_bits + db, right = nb + l->den_bits;
+    l->numerator = l->numerator * d + (__int128) n * l->denominator;
+    l->denominator *= d;
+    l->num_bits = (left > right ? left : right) + 1;
+    l->den_bits += db;
+    return RATIONAL_OK;
+}
+
+
+// multiplies a lazy_rational by n/d
+// -
+// args:
+// lazy_rational *l: accumulator
+// long long n, long long d: multiplier, |n| and |d| at most RATIONAL64_MAX (doesn't have to be simplified)
+// -
+// returns:
+// RATIONAL_OK or RATIONAL_ZERO_DENOMINATOR
+int lazy_multiply(lazy_rational *l, long long n, long long d) {
+    if (d == 0) return RATIONAL_ZERO_DENOMINATOR;
+    if (d < 0) {
+        n = -n;
+        d = -d;
+    }
+    int nb = bits128(n), db = bits128(d);
+    for (int attempt = 0; l->num_bits + nb > LAZY_BITS || l->den_bits + db > LAZY_BITS; attempt++) {
+        if (attempt == 0) lazy_reduce(l);
+        else lazy_flush(l);
+    }
+    // the spill is multiplied after any flush above so the flushed part gets multiplied too
+    if (l->spill.is_big || l->spill.numerator != 0) {
+        long long g = gcd64(n, d);
+        int status = big_multiply(&l->spill, &BIG_RATIONAL(n / g, d / g), &l->spill);
+        if (status != RATIONAL_OK) return status;
+    }
+    l->numerator *= n;
+    l->denominator *= d;
+    l->num_bits += nb;
+    l->den_bits += db;
+    return RATIONAL_OK;
+}
+
+
+// reads the exact value of a lazy_rational into a big_rational (reducing it first)
+// -
+// args:
+// lazy_rational *l: accumulator
+// big_rational *out: pointer to big_rational that stores the value
+// -
+// returns:
+// RATIONAL_OK
+int lazy_read(lazy_rational *l, big_rational *out) {
+    lazy_reduce(l);
+    lazy_flush(l);
+    return big_add(&l->spill, &BIG_RATIONAL(0, 1), out);
+}
+
+
+// streaming version of read_file_fast() + the summing loop in main(): reads one pair at a time, prints it,
+// simplifies it and adds it into *sum, then forgets it. memory use is constant no matter how big the input is
+// -
+// args:
+// scanner *s: input source
+// int n: max number of rationals to read (the size at the start of the file)
+// big_rational *sum: pointer to big_rational that stores the running sum
+// bucket_sum *buckets: if not NULL the pairs go into this (unsimplified) instead of *sum, see bucket_sum_add()
+// lazy_rational *lazy: same for a lazy_rational, see lazy_add()
+// int *status: set to the first error big_add() returned (RATIONAL_OK if none), *sum stops changing after that
+// -
+// returns:
+// number of rationals read, or -1 on a parse error (see scan_int())
+int stream_sum(scanner *s, int n, big_rational *sum, bucket_sum *buckets, lazy_rational *lazy, int *status) {
+    int count = 0;
+    rational x;
+    while (count < n) {
+        int loop = scan_int(s, &x.numerator);
+        if (loop == 1) loop = scan_int(s, &x.denominator);
+        if (loop == -1) return -1;
+        if (loop == 0) break;
+        if (count > 0) printf(", ");
+        if (count % FORMAT_COL == 0 && count > 0) printf("\n");
+        print_rational(&x);
+        count++;
+        if (buckets != NULL) {
+            bucket_sum_add(buckets, x.numerator, x.denominator);
+            continue;
+        }
+        if (lazy != NULL) {
+            if (*status == RATIONAL_OK) *status = lazy_add(lazy, x.numerator, x.denominator);
+            continue;
+        }
+        simplify(&x);
+        if (*status == RATIONAL_OK) *status = big_add(sum, &BIG_RATIONAL(x.numerator, x.denominator), sum);
+    }
+    if (count > 0 && count % FORMAT_COL == 0) printf("\n");
+    return count;
+}
+
+
+// struct sum_task typedef to sum_task
+// one worker's share of parallel_sum(): a slice of the mmap'd input and the partial sum of the pairs that start in it
+typedef struct sum_task {
+    const char *buf;    // the whole input
+    size_t buf_len;
+    size_t start;       // this worker's slice is buf[start, end), both ends on whitespace (or the ends of buf)
+    size_t end;
+    long long first;    // index (counting from 0 after the size) of the first integer in the slice
+    long long ints;     // number of integers in the slice
+    long long max_ints; // 2 * size, integers past this are ignored like read_file_fast() does
+    int use_buckets;    // sum through a bucket_sum instead of adding every pair with big_add()
+    big_rational sum;   // partial sum of every pair whose numerator is in the slice
+    int status;         // first error big_add() returned
+    int parse_error;    // 1 if scan_int() failed, err_offset says where
+    size_t err_offset;
+} sum_task;
+
+
+// first pass of parallel_sum(): counts the integers (runs of non-whitespace) in a slice without parsing them,
+// so every worker knows the index of its first integer and therefore whether it starts on a numerator
+void* count_worker(void *arg) {
+    sum_task *t = arg;
+    long long ints = 0;
+    int in_token = 0;
+    for (size_t i = t->start; i < t->end; i++) {
+        int space = IS_SPACE(t->buf[i]);
+        ints += !space & !in_token;
+        in_token = !space;
+    }
+    t->ints = ints;
+    return NULL;
+}
+
+
+// second pass of parallel_sum(): parses the slice and adds every pair whose numerator is in it into t->sum
+// a slice that starts on a denominator skips it (the previous pair's worker reads it), and a pair whose
+// denominator is past the end of the slice is finished by reading on into the next one
+void* sum_worker(void *arg) {
+    sum_task *t = arg;
+    scanner s = {.buf = t->buf + t->start, .len = t->end - t->start, .base = t->start};
+    long long index = t->first;
+    rational x;
+    int loop;
+    bucket_sum buckets;
+    t->sum = BIG_RATIONAL(0, 1);
+    t->status = RATIONAL_OK;
+    if (t->use_buckets) bucket_sum_init(&buckets);
+    if (index % 2 == 1 && index < t->max_ints) {
+        loop = scan_int(&s, &x.denominator);
+        index++;
+        if (loop == -1) goto parse_error;
+    }
+    int last = 0;
+    while (index < t->max_ints && !last) {
+        loop = scan_int(&s, &x.numerator);
+        if (loop == 0) break;
+        if (loop == 1) {
+            loop = scan_int(&s, &x.denominator);
+            if (loop == 0) {
+                // denominator is in a later slice (there can be empty slices in between), this is the last pair
+                s = (scanner) {.buf = t->buf + t->end, .len = t->buf_len - t->end, .base = t->end};
+                loop = scan_int(&s, &x.denominator);
+                if (loop == 0) break;
+                last = 1;
+            }
+        }
+        if (loop == -1) goto parse_error;
+        index += 2;
+        if (t->use_buckets) {
+            bucket_sum_add(&buckets, x.numerator, x.denominator);
+            continue;
+        }
+        simplify(&x);
+        if (t->status == RATIONAL_OK) t->status = big_add(&t->sum, &BIG_RATIONAL(x.numerator, x.denominator), &t->sum);
+    }
+    if (t->use_buckets) t->status = bucket_sum_finish(&buckets, &t->sum);
+    return NULL;
+
+parse_error:
+    if (t->use_buckets) bucket_sum_finish(&buckets, &t->sum);
+    t->parse_error = 1;
+    t->err_offset = s.err_offset;
+    return NULL;
+}
+
+
+// tree combine step of parallel_sum(): adds one partial sum into another
+void* combine_worker(void *arg) {
+    sum_task *t = arg;
+    sum_task *other = t + (t->first);
+    if (t->status == RATIONAL_OK) t->status = other->status;
+    if (t->status == RATIONAL_OK) t->status = big_add(&t->sum, &other->sum, &t->sum);
+    big_free(&other->sum);
+    return NULL;
+}
+
+
+// runs f(&tasks[i * stride]) for i in [0, n) on n threads and waits for all of them
+void run_threads(void* (*f)(void *), sum_task *tasks, int n, int stride) {
+    pthread_t *ids = malloc(n * sizeof(pthread_t));
+    int *started = malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        // if a thread can't be created just do its work on this one
+        started[i] = pthread_create(ids + i, NULL, f, tasks + (size_t) i * stride) == 0;
+        if (!started[i]) f(tasks + (size_t) i * stride);
+    }
+    for (int i = 0; i < n; i++) {
+        if (started[i]) pthread_join(ids[i], NULL);
+    }
+    free(ids);
+    free(started);
+}
+
+
+// multithreaded version of the summing loop in main() for mmap'd input
+// -
+// args:
+// scanner *s: mmap'd input, positioned just after the size
+// int n: max number of rationals to read (the size at the start of the file)
+// int threads: number of worker threads
+// int use_buckets: 1 if each worker should sum through a bucket_sum
+// big_rational *sum: pointer to big_rational that stores the sum
+// int *status: set to the first error big_add() returned (RATIONAL_OK if none)
+// -
+// returns:
+// number of rationals added into *sum, or -1 on a parse error (s->err_offset is set to the first one in the file)
+// -
+// the rest of the file is cut into one slice per thread, each cut moved forward to the next whitespace so no
+// number is split. the workers first count the integers in their slice (so each one knows whether it starts on
+// a numerator or a denominator), then parse and sum their pairs into partial big_rationals. the partials are
+// added together pairwise in a tree (also on threads) so the big additions at the top are between operands of
+// similar size. since big_rational arithmetic is exact and always fully reduced, the result is exactly the
+// same as summing sequentially
+int parallel_sum(scanner *s, int n, int threads, int use_buckets, big_rational *sum, int *status) {
+    const char *buf = s->buf;
+    size_t len = s->len;
+    size_t begin = s->pos;
+    sum_task *tasks = calloc(threads, sizeof(sum_task));
+    if (tasks == NULL) return -1;
+
+    size_t cut = begin;
+    for (int i = 0; i < threads; i++) {
+        tasks[i].buf = buf;
+        tasks[i].buf_len = len;
+        tasks[i].max_ints = 2LL * n;
+        tasks[i].use_buckets = use_buckets;
+        tasks[i].start = cut;
+        cut = (i == threads - 1) ? len : begin + (len - begin) / threads * (i + 1);
+        if (cut < tasks[i].start) cut = tasks[i].start;
+        while (cut < len && !IS_SPACE(buf[cut])) cut++;
+        tasks[i].end = cut;
+    }
+
+    run_threads(count_worker, tasks, threads, 1);
+    long long total = 0;
+    for (int i = 0; i < threads; i++) {
+        tasks[i].first = total;
+        total += tasks[i].ints;
+    }
+    run_threads(sum_worker, tasks, threads, 1);
+
+    int count = (int) ((total < 2LL * n) ? total / 2 : n);
+    for (int i = 0; i < threads; i++) {
+        if (tasks[i].parse_error) {
+            s->err_offset = tasks[i].err_offset;
+            count = -1;
+            break;
+        }
+    }
+
+    // tree combine: at each level task i absorbs task i + step, reusing first as the offset to the other task
+    for (int step = 1; step < threads; step *= 2) {
+        int pairs = 0;
+        for (int i = 0; i + step < threads; i += 2 * step) {
+            tasks[i].first = step;
+            pairs++;
+        }
+        run_threads(combine_worker, tasks, pairs, 2 * step);
+    }
+    *status = tasks[0].status;
+    big_free(sum);
+    *sum = tasks[0].sum;
+    free(tasks);
+    return count;
+}
+
+
+// binary rational file format ("ratbin"), all integers little endian:
+//   bytes 0-3    magic "RAT1"
+//   bytes 4-7    flags (RATBIN_INT64, RATBIN_SIMPLIFIED)
+//   bytes 8-15   count, number of rationals
+//   then count numerators followed by count denominators, 4 bytes each (8 with RATBIN_INT64)
+// storing the columns separately means reading them back is just indexing into the mmap'd file
+#define RATBIN_MAGIC "RAT1"
+#define RATBIN_HEADER 16
+#define RATBIN_INT64 1      // columns are 64 bit instead of 32 bit
+#define RATBIN_SIMPLIFIED 2 // every rational was already simplified by the writer
+
+// struct ratbin typedef to ratbin
+// view of a mmap'd ratbin file, nothing is copied
+typedef struct ratbin {
+    const unsigned char *numerators;
+    const unsigned char *denominators;
+    size_t count;
+    int width;          // bytes per value (4 or 8)
+    unsigned int flags;
+} ratbin;
+
+
+// writes the low `bytes` bytes of v into p, least significant first
+void put_le(unsigned char *p, unsigned long long v, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = (unsigned char) (v >> (8 * i));
+}
+
+
+// reads a little endian integer of `bytes` bytes from p (compiles down to a plain load on little endian cpus)
+unsigned long long get_le(const unsigned char *p, int bytes) {
+    unsigned long long v = 0;
+    for (int i = 0; i < bytes; i++) v |= (unsigned long long) p[i] << (8 * i);
+    return v;
+}
+
+
+// value i of a ratbin column, sign extended
+long long ratbin_value(const ratbin *b, const unsigned char *column, size_t i) {
+    if (b->width == 8) return (long long) get_le(column + 8 * i, 8);
+    return (int) (unsigned int) get_le(column + 4 * i, 4);
+}
+
+
+// checks whether the scanner's input is a ratbin file and if so points *b at its columns
+// -
+// args:
+// const scanner *s: freshly opened scanner
+// ratbin *b: pointer to ratbin that's filled in
+// -
+// returns:
+// 1 if it's a valid ratbin file, 0 if it isn't one (it's text, or it isn't mmap'd), -1 if it has the magic
+// but is truncated
+int ratbin_open(const scanner *s, ratbin *b) {
+    if (s->map == NULL || s->len < RATBIN_HEADER || memcmp(s->buf, RATBIN_MAGIC, 4) != 0) return 0;
+    const unsigned char *p = (const unsigned char *) s->buf;
+    b->flags = (unsigned int) get_le(p + 4, 4);
+    b->count = (size_t) get_le(p + 8, 8);
+    b->width = (b->flags & RATBIN_INT64) ? 8 : 4;
+    if (b->count > (s->len - RATBIN_HEADER) / (2 * (size_t) b->width)) return -1;
+    b->numerators = p + RATBIN_HEADER;
+    b->denominators = b->numerators + b->count * b->width;
+    return 1;
+}
+
+
+// converts a text file in the "size n1 d1 n2 d2 ..." format into a ratbin file with 32 bit columns
+// -
+// args:
+// const char *in: text file to read ("-" for stdin)
+// const char *out: ratbin file to write
+// int simplify_values: 1 to simplify every rational on the way (sets RATBIN_SIMPLIFIED)
+// -
+// returns:
+// 0 on success, 1 on any error (reported on stderr)
+// -
+// memory use doesn't depend on the file size: numerators go straight to out, denominators are buffered in a
+// temp file and appended once the numerators are done, then the header is rewritten with the real count
+int ratbin_convert(const char *in, const char *out, int simplify_values) {
+    scanner s;
+    if (scanner_open(&s, in) != 0) {
+        fprintf(stderr, "could not open %s\n", in);
+        return 1;
+    }
+    int size;
+    if (scan_int(&s, &size) != 1 || size < 0) {
+        fprintf(stderr, "parse error at byte offset %zu: expected array size\n", s.err_offset);
+        scanner_close(&s);
+        return 1;
+    }
+    FILE *f = fopen(out, "wb");
+    FILE *dens = tmpfile();
+    if (f == NULL || dens == NULL) {
+        fprintf(stderr, "could not open %s\n", (f == NULL) ? out : "temp file");
+        if (f != NULL) fclose(f);
+        if (dens != NULL) fclose(dens);
+        scanner_close(&s);
+        return 1;
+    }
+
+    unsigned char header[RATBIN_HEADER] = {0};
+    fwrite(header, 1, RATBIN_HEADER, f);
+
+    // convert in blocks so simplify_batch() gets whole arrays to work on
+    enum { BLOCK = 4096 };
+    rational block[BLOCK];
+    unsigned char bytes[4 * BLOCK];
+    size_t count = 0;
+    int loop = 1;
+    while (loop > 0 && count < (size_t) size) {
+        int want = ((size_t) size - count < BLOCK) ? (int) ((size_t) size - count) : BLOCK;
+        loop = read_file_fast(&s, block, want);
+        if (loop < 0) break;
+        if (simplify_values) simplify_batch(block, loop);
+        for (int i = 0; i < loop; i++) put_le(bytes + 4 * i, (unsigned int) block[i].numerator, 4);
+        fwrite(bytes, 4, loop, f);
+        for (int i = 0; i < loop; i++) put_le(bytes + 4 * i, (unsigned int) block[i].denominator, 4);
+        fwrite(bytes, 4, loop, dens);
+        count += loop;
+        if (loop < want) break;
+    }
+    if (loop < 0) {
+        fprintf(stderr, "parse error at byte offset %zu\n", s.err_offset);
+        fclose(dens);
+        fclose(f);
+        scanner_close(&s);
+        return 1;
+    }
+
+    rewind(dens);
+    size_t got;
+    while ((got = fread(bytes, 1, sizeof(bytes), dens)) > 0) fwrite(bytes, 1, got, f);
+
+    memcpy(header, RATBIN_MAGIC, 4);
+    put_le(header + 4, simplify_values ? RATBIN_SIMPLIFIED : 0, 4);
+    put_le(header + 8, count, 8);
+    fseek(f, 0, SEEK_SET);
+    fwrite(header, 1, RATBIN_HEADER, f);
+
+    int failed = ferror(f) || ferror(dens);
+    failed |= fclose(f) != 0;
+    fclose(dens);
+    scanner_close(&s);
+    if (failed) {
+        fprintf(stderr, "error writing %s\n", out);
+        return 1;
+    }
+    printf("wrote %zu rationals to %s\n", count, out);
+    return 0;
+}
+
+
+// ratbin version of stream_sum(): prints every rational in b and adds it into *sum (or *buckets)
+// -
+// args:
+// const ratbin *b: mmap'd ratbin file
+// big_rational *sum: pointer to big_rational that stores the running sum
+// bucket_sum *buckets: if not NULL the pairs go into this instead of *sum (32 bit files only)
+// lazy_rational *lazy: if not NULL the pairs go into this instead of *sum
+// int *status: set to the first error big_add() returned (RATIONAL_OK if none)
+// -
+// returns:
+// number of rationals read
+size_t ratbin_sum(const ratbin *b, big_rational *sum, bucket_sum *buckets, lazy_rational *lazy, int *status) {
+    for (size_t i = 0; i < b->count; i++) {
+        long long n = ratbin_value(b, b->numerators, i);
+        long long d = ratbin_value(b, b->denominators, i);
+        printf("%lld/%lld", n, d);
+        if (i < b->count - 1) printf(", ");
+        if ((i+1) % FORMAT_COL == 0) printf("\n");
+        if (buckets != NULL && b->width == 4) {
+            bucket_sum_add(buckets, (int) n, (int) d);
+            continue;
+        }
+        if (*status != RATIONAL_OK) continue;
+        if (lazy != NULL) {
+            *status = lazy_add(lazy, n, d);
+            continue;
+        }
+        if (d == 0) {
+            *status = RATIONAL_ZERO_DENOMINATOR;
+            continue;
+        }
+        if (!(b->flags & RATBIN_SIMPLIFIED)) {
+            long long g = gcd64(n, d);
+            n /= g;
+            d /= g;
+        }
+        if (d < 0) {
+            n = -n;
+            d = -d;
+        }
+        *status = big_add(sum, &BIG_RATIONAL(n, d), sum);
+    }
+    return b->count;
+}
+
+
+int main(int argc, char *argv[]) {
+    // usage: arr_in [-s | -p threads] [file]
+    //        arr_in [-d | -l] ...
+    //        arr_in -c out [-S] [file]
+    //        arr_in -b [n]
+    // (build with -pthread)
+    // -s streams the file through stream_sum() instead of loading it into an array first
+    // -p sums the file on that many threads with parallel_sum() (0 = one per core) and doesn't print the list.
+    //    needs a regular file, anything else falls back to the default mode
+    // -d sums through a bucket_sum (one integer add per pair, one big_add() per distinct denominator), works
+    //    with every mode
+    // -l sums through a lazy_rational (gcd only when 128 bits might overflow) and prints how many gcd reductions
+    //    that took, works with every mode but -p
+    // -c converts the text file to the binary ratbin format (see RATBIN_MAGIC) in out, -S simplifies on the way.
+    //    ratbin files are detected automatically by every other mode, though -p sums them sequentially
+    // -b runs gcd_benchmark() and batch_benchmark() on n (default 10000000) random rationals instead of reading
+    //    a file
+    // file is mmap'd if possible, "-" or no argument reads stdin
+    int streaming = 0;
+    int threads = -1;
+    int use_buckets = 0;
+    int use_lazy = 0;
+    int presimplify = 0;
+    const char *convert_path = NULL;
+    const char *path = "-";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0) streaming = 1;
+        else if (strcmp(argv[i], "-d") == 0) use_buckets = 1;
+        else if (strcmp(argv[i], "-l") == 0) use_lazy = 1;
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) convert_path = argv[++i];
+        else if (strcmp(argv[i], "-S") == 0) presimplify = 1;
+        else if (strcmp(argv[i], "-b") == 0) {
+            int n = (i + 1 < argc) ? atoi(argv[i + 1]) : 10000000;
+            return gcd_benchmark(n) | batch_benchmark(n);
+        }
+        else path = argv[i];
+    }
+    if (convert_path != NULL) return ratbin_convert(path, convert_path, presimplify);
+
+    scanner s;
+    if (scanner_open(&s, path) != 0) {
+        fprintf(stderr, "could not open %s\n", path);
+        return 1;
+    }
+    printf("\nfile: %s\n\n", path);
+
+    // binary files are used as-is, text files start with the array size
+    ratbin bin;
+    int binary = ratbin_open(&s, &bin);
+    if (binary < 0) {
+        fprintf(stderr, "%s is a truncated ratbin file\n", path);
+        scanner_close(&s);
+        return 1;
+    }
+    int size = 0;
+    if (!binary && (scan_int(&s, &size) != 1 || size < 0)) {
+        fprintf(stderr, "parse error at byte offset %zu: expected array size\n", s.err_offset);
+        scanner_close(&s);
+        return 1;
+    }
+
+    // print rationals and print out the sum/average
+    // the sum is a big_rational so it stays exact however big its denominator gets
+    printf("rationals:\n[ \n");
+    big_rational r = BIG_RATIONAL(0, 1);
+    int status = RATIONAL_OK;
+    long long count;
+    bucket_sum buckets;
+    lazy_rational lazy;
+    if (threads == 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    // parallel_sum() sums straight into r, so -l has nothing to add there
+    int parallel = !binary && threads > 0 && s.map != NULL;
+    use_lazy &= !use_buckets && !parallel;
+    if (use_buckets) bucket_sum_init(&buckets);
+    else if (use_lazy) lazy_init(&lazy);
+    if (binary) {
+        count = (long long) ratbin_sum(&bin, &r, use_buckets ? &buckets : NULL, use_lazy ? &lazy : NULL, &status);
+    }
+    else if (parallel) {
+        count = parallel_sum(&s, size, threads, use_buckets, &r, &status);
+        printf("(%lld rationals summed on %d threads)\n", (count > 0) ? count : 0, threads);
+    }
+    else if (streaming) {
+        count = stream_sum(&s, size, &r, use_buckets ? &buckets : NULL, use_lazy ? &lazy : NULL, &status);
+    }
+    else {
+        // load everything into a heap array (sized by the file, so it can't go on the stack)
+        rational *fractions = malloc((size > 0 ? size : 1) * sizeof(rational));
+        if (fractions == NULL) {
+            fprintf(stderr, "could not allocate %d rationals, try -s\n", size);
+            scanner_close(&s);
+            return 1;
+        }
+        count = read_file_fast(&s, fractions, size);
+        for (int i = 0; i < count; i++) {
+            print_rational(fractions + i);
+            if (i < count - 1) printf(", ");
+            if ((i+1) % FORMAT_COL == 0) printf("\n");
+        }
+        if (use_buckets) {
+            for (int i = 0; i < count; i++) bucket_sum_add(&buckets, fractions[i].numerator, fractions[i].denominator);
+        }
+        else if (use_lazy) {
+            for (int i = 0; i < count && status == RATIONAL_OK; i++) {
+                status = lazy_add(&lazy, fractions[i].numerator, fractions[i].denominator);
+            }
+        }
+        else {
+            // scalar simplify(): gcd_benchmark() still has it ahead of simplify_batch()
+            for (int i = 0; i < count && status == RATIONAL_OK; i++) {
+                simplify(fractions + i);
+                status = big_add(&r, &BIG_RATIONAL(fractions[i].numerator, fractions[i].denominator), &r);
+            }
+        }
+        free(fractions);
+    }
+    if (use_buckets) {
+        int bucket_status = bucket_sum_finish(&buckets, &r);
+        if (status == RATIONAL_OK) status = bucket_status;
+    }
+    long long reductions = 0;
+    if (use_lazy) {
+        if (status == RATIONAL_OK) status = lazy_read(&lazy, &r);
+        reductions = lazy.reductions;
+        lazy_free(&lazy);
+    }
+    if (count < 0) {
+        fprintf(stderr, "\nparse error at byte offset %zu\n", s.err_offset);
+        big_free(&r);
+        scanner_close(&s);
+        return 1;
+    }
+    printf("\n]\n\nsum:\n");
+    if (status == RATIONAL_OK) {
+        big_print(&r);
+        status = big_multiply(&r, &BIG_RATIONAL(1, (count > 0) ? count : 1), &r);
+    }
+    else printf("zero denominator");
 
-    r.denominator *= 50;
-    simplify(&r);
     printf("\n\naverage:\n");
-    print_rational(&r);
+    if (status == RATIONAL_OK) big_print(&r);
+    else printf("zero denominator");
+    // one gcd per value is what the other modes do
+    if (use_lazy) printf("\n\ngcd reductions:\n%lld for %lld rationals", reductions, count);
     printf("\n\n");
     
     // close file
-    fclose(f);
+    big_free(&r);
+    scanner_close(&s);
     return 0;
 }
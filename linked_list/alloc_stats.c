@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+#include "alloc_stats.h"
+
+
+#if ALLOC_STATS
+
+// allocation counters (typedef to just alloc_stats), these replace the old malloc_num which only counted allocations
+// still on the heap. allocations and frees are counted per site with their bytes, plus a histogram of the sizes
+// allocated, so a leak shows up under the site that made it. only the peak is a total
+// every counter is updated with relaxed atomics, so it's safe to count from several threads and to take a snapshot
+// with alloc_stats_dump() at any time. pool nodes count as one allocation each, not the slabs they come out of
+typedef struct alloc_stats {
+    long long allocs[MAX_SITES];
+    long long frees[MAX_SITES];
+    long long bytes[MAX_SITES];       // bytes allocated in total
+    long long bytes_live[MAX_SITES];  // bytes allocated and not freed yet
+    long long sizes[MAX_SITES][SIZE_BUCKETS];
+    long long total_live;             // sum of bytes_live, kept separately so the peak can be tracked
+    long long peak_bytes;
+} alloc_stats;
+
+alloc_stats stats;
+
+const char *const *stats_site_names = NULL; // set by alloc_stats_sites()
+int stats_sites = 0;
+
+
+// alloc_stats_sites() names the program's call sites, see alloc_stats.h
+void alloc_stats_sites(const char *const *names, int count) {
+    stats_site_names = names;
+    stats_sites = (count < MAX_SITES) ? count : MAX_SITES;
+}
+
+
+// stats_resize() counts memory allocated at site growing by bytes (or shrinking if it's negative) and keeps
+// peak_bytes up to date. realloc()s call it directly since they aren't new allocations
+void stats_resize(int site, long long bytes) {
+    __atomic_fetch_add(&stats.bytes_live[site], bytes, __ATOMIC_RELAXED);
+    long long live = __atomic_add_fetch(&stats.total_live, bytes, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&stats.peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&stats.peak_bytes, &peak, live, 1, __ATOMIC_RELAXED,
+                                                       __ATOMIC_RELAXED));
+}
+
+
+// stats_alloc() counts n allocations of size bytes each at site
+void stats_alloc(int site, size_t size, long long n) {
+    int bucket = (size == 0) ? 0 : 63 - __builtin_clzll(size);
+    if (bucket >= SIZE_BUCKETS) bucket = SIZE_BUCKETS - 1;
+    __atomic_fetch_add(&stats.allocs[site], n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.bytes[site], (long long) size * n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.sizes[site][bucket], n, __ATOMIC_RELAXED);
+    stats_resize(site, (long long) size * n);
+}
+
+
+// stats_free() counts n frees of size bytes each of memory allocated at site
+void stats_free(int site, size_t size, long long n) {
+    __atomic_fetch_add(&stats.frees[site], n, __ATOMIC_RELAXED);
+    stats_resize(site, -(long long) size * n);
+}
+
+
+// alloc_live() returns the number of allocations that haven't been freed, over every site
+long long alloc_live(void) {
+    long long live = 0;
+    for (int s = 0; s < MAX_SITES; s++) {
+        live += __atomic_load_n(&stats.allocs[s], __ATOMIC_RELAXED);
+        live -= __atomic_load_n(&stats.frees[s], __ATOMIC_RELAXED);
+    }
+    return live;
+}
+
+
+// alloc_stats_dump() writes a snapshot of alloc_stats to f as JSON, e.g.
+// {"enabled": true, "allocs": 3, "frees": 1, "live": 2, "bytes_live": 48, "peak_bytes": 72, "size_buckets": 16,
+//  "sites": {"append": {"allocs": 3, "frees": 1, "live": 2, "bytes": 72, "bytes_live": 48,
+//                       "sizes": [0, 0, 0, 0, 3, 0, ...]}, ...}}
+// sizes[b] counts allocations of [2^b, 2^(b+1)) bytes. other threads can keep counting while it runs, so the
+// numbers can be a few allocations apart from each other then
+void alloc_stats_dump(FILE *f) {
+    long long allocs = 0;
+    long long frees = 0;
+    for (int s = 0; s < MAX_SITES; s++) {
+        allocs += __atomic_load_n(&stats.allocs[s], __ATOMIC_RELAXED);
+        frees += __atomic_load_n(&stats.frees[s], __ATOMIC_RELAXED);
+    }
+    fprintf(f, "{\"enabled\": true, \"allocs\": %lld, \"frees\": %lld, \"live\": %lld, \"bytes_live\": %lld, "
+               "\"peak_bytes\": %lld, \"size_buckets\": %d,\n \"sites\": {", allocs, frees, allocs - frees,
+            __atomic_load_n(&stats.total_live, __ATOMIC_RELAXED),
+            __atomic_load_n(&stats.peak_bytes, __ATOMIC_RELAXED), SIZE_BUCKETS);
+    for (int s = 0; s < stats_sites; s++) {
+        long long site_allocs = __atomic_load_n(&stats.allocs[s], __ATOMIC_RELAXED);
+        long long site_frees = __atomic_load_n(&stats.frees[s], __ATOMIC_RELAXED);
+        fprintf(f, "%s\n  \"%s\": {\"allocs\": %lld, \"frees\": %lld, \"live\": %lld, \"bytes\": %lld, "
+                   "\"bytes_live\": %lld, \"sizes\": [", (s > 0) ? "," : "", stats_site_names[s], site_allocs,
+                site_frees, site_allocs - site_frees, __atomic_load_n(&stats.bytes[s], __ATOMIC_RELAXED),
+                __atomic_load_n(&stats.bytes_live[s], __ATOMIC_RELAXED));
+        for (int b = 0; b < SIZE_BUCKETS; b++) {
+            fprintf(f, "%s%lld", (b > 0) ? ", " : "", __atomic_load_n(&stats.sizes[s][b], __ATOMIC_RELAXED));
+        }
+        fprintf(f, "]}");
+    }
+    fprintf(f, "}}\n");
+}
+
+#else
+
+void alloc_stats_dump(FILE *f) {
+    fprintf(f, "{\"enabled\": false}\n");
+}
+
+#endif
+
+
+const char *stats_path = NULL;
+
+
+// dump_stats_at_exit() is the atexit() handler that writes the alloc_stats snapshot to stats_path
+void dump_stats_at_exit(void) {
+    if (stats_path == NULL) return;
+    FILE *f = (strcmp(stats_path, "-") == 0) ? stdout : fopen(stats_path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "could not open %s\n", stats_path);
+        return;
+    }
+    alloc_stats_dump(f);
+    if (f != stdout) fclose(f);
+}
@@ -0,0 +1,56 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// allocation counters shared by linked_list.c and double_list.c (see alloc_stats.c), build alloc_stats.c into
+// whichever program uses them. every counter is kept per call site: each program has its own enum of sites and
+// passes its names to alloc_stats_sites() before counting anything
+
+#ifndef ALLOC_STATS
+#define ALLOC_STATS 1   // count allocations, build everything (alloc_stats.c too) with -DALLOC_STATS=0 to compile
+                        // the counting out completely
+#endif
+#define MAX_SITES 16    // most call sites a program can count under
+#define SIZE_BUCKETS 16 // buckets of the size histograms: bucket b counts sizes in [2^b, 2^(b+1)), the last one
+                        // everything bigger
+
+#if ALLOC_STATS
+
+// names the program's call sites (count of them, at most MAX_SITES), the names are used as they are
+void alloc_stats_sites(const char *const *names, int count);
+
+// counts n allocations of size bytes each at site
+void stats_alloc(int site, size_t size, long long n);
+
+// counts n frees of size bytes each of memory that was allocated at site
+void stats_free(int site, size_t size, long long n);
+
+// counts memory allocated at site growing by bytes (or shrinking if it's negative), for realloc()
+void stats_resize(int site, long long bytes);
+
+// number of allocations that haven't been freed (what malloc_num used to be), -1 if ALLOC_STATS is 0
+long long alloc_live(void);
+
+#else
+
+// ALLOC_STATS is 0: nothing is counted, the arguments are only there so unused variables don't warn
+#define alloc_stats_sites(names, count) ((void) (names), (void) (count))
+#define stats_alloc(site, size, n) ((void) (site), (void) (size), (void) (n))
+#define stats_free(site, size, n) ((void) (site), (void) (size), (void) (n))
+#define stats_resize(site, bytes) ((void) (site), (void) (bytes))
+#define alloc_live() (-1LL)
+
+#endif
+
+// writes a snapshot of the counters to f as JSON
+void alloc_stats_dump(FILE *f);
+
+// where dump_stats_at_exit() writes the snapshot, NULL for nowhere and "-" for stdout
+extern const char *stats_path;
+
+// atexit() handler that writes the snapshot to stats_path
+void dump_stats_at_exit(void);
+
+#endif
@@ -1,10 +1,27 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>  
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "alloc_stats.h"
 
 #define ARR_SIZE 200 // used to set the size of the linked node
 #define RANGE 49    // used to determine the range of numbers that should be in linked node [0-RANGE] inclusive
 #define FORMAT_COLUMNS 8 // used to formate columns in print_node
+#define SLAB_NODES 65536 // number of nodes carved out of each slab of the node pool
+#define PRINT_LIMIT 1000 // lists longer than this aren't printed
+#define DENSE_FACTOR 64  // dedup_init() uses a bitset if the value range is at most this many times the list length
+                         // (at that point the bitset takes no more memory than the hash set would)
+#define PARALLEL_MIN 65536 // lists shorter than this aren't worth splitting across threads in parallel_dedup()
+#define UNROLLED_CAP 27  // values per unrolled node, which makes a node 128 bytes (two cache lines) on 64 bit builds
+#define UNROLLED_EDITS 100000 // random inserts/deletes unrolled_check() runs on an unrolled list
+#define NIL 0xFFFFFFFFu  // "NULL" index in an index_dlist
+#define INDEX_MAGIC "IDL1" // first 4 bytes of a file written by idl_save()
+#define CC_MAX_THREADS 64    // most threads that can use cc_lists at once (one hazard pointer each)
+#define CC_RETIRE_BATCH 128  // popped nodes a thread collects before checking which ones it can free
 #define VERBOSE_PRINT 0 // print VERBOSE or not (if 1, then when printing, the following thing will be printed for each node:
                         // - value
                         // - prev node's address
@@ -14,9 +31,20 @@
                         // check the connections
 
 
-// sanity checker to make sure malloc() and free() are called the same number of times
-// keeps track of number of variables currently on heap (to avoid memory leaks)
-int malloc_num = 0;
+// places allocations are counted under in alloc_stats (typedef to just alloc_site)
+typedef enum alloc_site {
+    SITE_APPEND,        // append(), so initialize()'s nodes too
+    SITE_INITIALIZE,    // initialize()'s double_list itself
+    SITE_COMPACT_LIST,  // compact_list()'s block
+    SITE_INDEX_DLIST,   // index_dlist arrays
+    SITE_UNROLLED,      // unrolled lists and their nodes
+    SITE_CC_LIST,       // cc_list nodes
+    SITE_LOCKED_LIST,   // locked_list nodes
+    SITES
+} alloc_site;
+
+const char *site_names[SITES] = {"append", "initialize", "compact_list", "index_dlist", "unrolled", "cc_list",
+                                 "locked_list"};
 
 
 // linked node struct (typedef to just node)
@@ -30,36 +58,239 @@ typedef struct node {
 typedef struct double_list {
     node *first;
     node *last;
+    alloc_site site;    // where its nodes were counted in alloc_stats (SITE_APPEND, SITE_COMPACT_LIST once compacted)
 } double_list;
 
+// unrolled node struct (typedef to just unode) - holds up to UNROLLED_CAP values in order, so most steps through an
+// unrolled list are along an array instead of to another node
+typedef struct unode {
+    struct unode *next;
+    struct unode *prev;
+    int count;
+    int values[UNROLLED_CAP];
+} unode;
+
+// compact doubly linked list storage (typedef to just index_dlist): values and links live in growable arrays indexed
+// by slot and links are 32 bit indexes, NIL marking either end. that's 12 bytes per element instead of node's 24.
+// with xor_links set there's no prevs array and links[i] holds next ^ prev instead (8 bytes per element), which
+// still lets the list be walked either way as long as the node you came from is known. deleted slots go on a free
+// list chained through links. there are no pointers in it so it can be written to disk as it is (see idl_save())
+typedef struct index_dlist {
+    int *values;
+    unsigned *links;    // next index, or next ^ prev with xor_links
+    unsigned *prevs;    // prev index, NULL with xor_links
+    unsigned cap;       // slots in the arrays
+    unsigned used;      // slots that have ever been handed out
+    unsigned first;
+    unsigned last;
+    unsigned free;      // first free slot
+    unsigned length;
+    int xor_links;
+} index_dlist;
+
+// unrolled doubly linked list struct (typedef to just unrolled_list)
+typedef struct unrolled_list {
+    unode *first;
+    unode *last;
+} unrolled_list;
+
+
+// slab of nodes handed out by the node pool (typedef to just slab)
+// slabs are chained together through next so the whole pool can be given back in one go. they're normally
+// SLAB_NODES nodes long, but compact_list() also adds blocks sized to the list it compacts
+typedef struct slab {
+    struct slab *next;
+    int size;        // nodes in the slab
+    node nodes[];
+} slab;
+
+// node pool - instead of one malloc() per node, nodes are bumped out of big slabs and freed nodes are pushed onto an
+// intrusive free list threaded through their own next pointers (typedef to just node_pool)
+// nodes are bumped from the top of a slab downwards since append() pushes to the front, that way a list built by
+// initialize() runs forwards through memory
+typedef struct node_pool {
+    slab *slabs;     // newest slab first
+    int left;        // nodes not yet bumped out of the newest slab
+    node *free;      // recycled nodes
+    int live;        // nodes currently handed out
+} node_pool;
+
+node_pool pool = {NULL, 0, NULL, 0};
+
 
 // my_free function used to keep track of memory deletions
-// malloc_num counts the number of variables currently on heap
-void my_free(void *p) {
+// counts the free in alloc_stats, size and site are what it was allocated with
+void my_free(void *p, size_t size, alloc_site site) {
     free(p);
-    malloc_num--;
+    stats_free(site, size, 1);
+}
+
+
+// my_malloc function that calls malloc() and also counts the allocation under site in alloc_stats (if it worked)
+void* my_malloc(size_t size, alloc_site site) {
+    void *p = malloc(size);
+    if (p != NULL) stats_alloc(site, size, 1);
+    return p;
 }
 
 
-// free_node function recursively frees each node of the double node
+// node_alloc() hands out a node from the pool, it counts as one allocation under site in alloc_stats
+// -
+// returns:
+// pointer to an uninitialized node
+node* node_alloc(alloc_site site) {
+    node *n;
+    stats_alloc(site, sizeof(node), 1);
+    pool.live++;
+    if (pool.free != NULL) {
+        n = pool.free;
+        pool.free = n->next;
+        return n;
+    }
+    if (pool.left == 0) {
+        slab *s = malloc(sizeof(slab) + SLAB_NODES * sizeof(node));
+        if (s == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        s->next = pool.slabs;
+        s->size = SLAB_NODES;
+        pool.slabs = s;
+        pool.left = SLAB_NODES;
+    }
+    return &pool.slabs->nodes[--pool.left];
+}
+
+
+// node_free() gives a node back to the pool (pushes it onto the free list) and counts it as freed at site (where
+// it was allocated)
+void node_free(node *n, alloc_site site) {
+    n->next = pool.free;
+    pool.free = n;
+    stats_free(site, sizeof(node), 1);
+    pool.live--;
+}
+
+
+// pool_free_chain() gives a chain of count nodes (linked through next, first to last) that were allocated at site
+// back to the pool in O(1)
+void pool_free_chain(node *first, node *last, int count, alloc_site site) {
+    if (count == 0) return;
+    last->next = pool.free;
+    pool.free = first;
+    stats_free(site, sizeof(node), count);
+    pool.live -= count;
+}
+
+
+// pool_release() is the bulk free - it gives every slab back with free() in O(slabs). lists should be handed back
+// with free_list() first: nodes still handed out when it's called are leaks, so they stay counted as live in
+// alloc_stats
+// -
+// returns:
+// the number of nodes that were still handed out (leaked)
+int pool_release() {
+    int leaked = pool.live;
+    while (pool.slabs != NULL) {
+        slab *s = pool.slabs;
+        pool.slabs = s->next;
+        free(s);
+    }
+    pool.left = 0;
+    pool.free = NULL;
+    pool.live = 0;
+    return leaked;
+}
+
+
+// slab_compare() orders slabs by address for qsort()/slab_find()
+int slab_compare(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) *(slab * const *) a;
+    uintptr_t y = (uintptr_t) *(slab * const *) b;
+    return (x > y) - (x < y);
+}
+
+
+// slab_find() returns the index of the slab n was carved out of, in an array of k slabs sorted by slab_compare()
+int slab_find(slab **sorted, int k, node *n) {
+    int lo = 0;
+    int hi = k - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if ((uintptr_t) sorted[mid] <= (uintptr_t) n) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+
+// pool_trim() gives every slab that has no node handed out back with free(), dropping its nodes from the free
+// list. it walks the free list twice with a binary search over the slabs per node, so it's meant for after a big
+// batch of frees (like compact_list()) rather than after every one
+// -
+// returns:
+// the number of slabs freed (0 if there wasn't enough memory to sort them, the pool is left alone then)
+int pool_trim() {
+    int k = 0;
+    for (slab *s = pool.slabs; s != NULL; s = s->next) k++;
+    if (k == 0) return 0;
+    slab **sorted = malloc(k * sizeof(slab *));
+    int *idle = calloc(k, sizeof(int));
+    if (sorted == NULL || idle == NULL) {
+        free(sorted);
+        free(idle);
+        return 0;
+    }
+    k = 0;
+    for (slab *s = pool.slabs; s != NULL; s = s->next) sorted[k++] = s;
+    qsort(sorted, k, sizeof(slab *), slab_compare);
+    // nodes the newest slab hasn't bumped out yet are as unused as the ones on the free list
+    idle[slab_find(sorted, k, pool.slabs->nodes)] += pool.left;
+    for (node *n = pool.free; n != NULL; n = n->next) idle[slab_find(sorted, k, n)]++;
+
+    node first;
+    node *tail = &first;
+    for (node *n = pool.free; n != NULL; n = n->next) {
+        int i = slab_find(sorted, k, n);
+        if (idle[i] == sorted[i]->size) continue;
+        tail->next = n;
+        tail = n;
+    }
+    tail->next = NULL;
+    pool.free = first.next;
+    int freed = 0;
+    slab **link = &pool.slabs;
+    while (*link != NULL) {
+        slab *s = *link;
+        int i = slab_find(sorted, k, s->nodes);
+        if (idle[i] != s->size) {
+            link = &s->next;
+            continue;
+        }
+        // whichever slab ends up newest was bumped out completely before the one being freed was added
+        if (s == pool.slabs) pool.left = 0;
+        *link = s->next;
+        free(s);
+        freed++;
+    }
+    free(sorted);
+    free(idle);
+    return freed;
+}
+
+
+// free_list function hands each node of the double list back to the node pool, then frees the list itself
 // since the address itself is cleared, we don't have to worry about whether connections will mess anything up
 // (in other words if a node is deleted, all connections to it will then point to NULL due to this)
-// uses my_free() function (see line 38)
+// uses node_free() and my_free() (see above)
 void free_list(double_list *root) {
     node *n = root->first;
     while (n != NULL) {
         node *temp = n;
         n = n->next;
-        my_free(temp);
+        node_free(temp, root->site);
     }   
-    my_free(root);
-}
-
-
-// my_malloc function that calls malloc() and also increments malloc_num (see line 19)
-void* my_malloc(int size) {
-    malloc_num++;
-    return malloc(size);
+    my_free(root, sizeof(double_list), SITE_INITIALIZE);
 }
 
 
@@ -100,7 +331,7 @@ void print_node(node *node) {
 // returns:
 // pointer to new root node with data as its value
 node* append(node *n, int data) {
-    node *d = my_malloc(sizeof(node));
+    node *d = node_alloc(SITE_APPEND);
     d->value = data;
     d->prev = NULL;
     d->next = n;
@@ -111,13 +342,14 @@ node* append(node *n, int data) {
 
 // initialize() makes a doubly linked node from an array
 double_list* initialize(int (*arr)[], int size) {
-    double_list *ret = my_malloc(sizeof(double_list));
+    double_list *ret = my_malloc(sizeof(double_list), SITE_INITIALIZE);
     node *root = NULL;
     for (int i = size - 1; i > -1; i--) {
         root = append(root, *(*arr + i));
         if (i == size - 1) ret->last = root;
     }
     ret->first = root;
+    ret->site = SITE_APPEND;
     return ret;
 }
 
@@ -126,11 +358,12 @@ double_list* initialize(int (*arr)[], int size) {
 // -
 // args:
 // node *n: a pointer corresponding to the address of the node to be deleted
+// alloc_site site: where n was allocated (the list's site)
 // -
 // returns:
 // a node* pointer corresponding to the address of the previous node. this node's internal variables for 
 // next and prev are updated accordingly and edge cases are accounted for (deleting the first/last node)
-node* delete(node *n) {
+node* delete(node *n, alloc_site site) {
     // printf("%p\n", node);
     node *previous = n->prev;
     node *old_root = n;
@@ -140,57 +373,1655 @@ node* delete(node *n) {
     }
     else previous->next = n->next;
     if (n->next != NULL) n->next->prev = previous;
-    my_free(old_root);
+    node_free(old_root, site);
     return previous;
 }
 
 
+// set of ints seen so far, for delete_duplicates() (struct dedup_set typedef to dedup_set)
+// it's one of two things, picked by dedup_init() from the list's length and value range:
+// - a bitset with one bit per value in [min, max], when the range is dense
+// - an open-addressing hash set: a power-of-two array of keys with linear probing, pre-sized to at least twice the
+//   list's length so it never has to grow and probes stay short. INT_MIN marks an empty slot, so INT_MIN itself
+//   is tracked with a flag
+typedef struct dedup_set {
+    unsigned long long *bits;  // bitset (NULL if this is a hash set)
+    int min;                   // value of bit 0
+    int *keys;                 // hash set slots
+    size_t mask;               // number of slots - 1
+    int shift;                 // 64 - log2(number of slots), hashes use the top bits of the product
+    int has_min_int;           // 1 once INT_MIN has been inserted into the hash set
+} dedup_set;
+
+
+// dedup_init_range() sets up a dedup_set for length values in [min, max]
+// -
+// returns:
+// 0, or -1 if the set couldn't be allocated
+int dedup_init_range(dedup_set *set, size_t length, int min, int max) {
+    memset(set, 0, sizeof(dedup_set));
+    unsigned long long span = (unsigned long long) ((long long) max - min) + 1;
+    if (span / DENSE_FACTOR <= length) {
+        set->min = min;
+        set->bits = calloc((span + 63) / 64, sizeof(unsigned long long));
+        return (set->bits == NULL) ? -1 : 0;
+    }
+    size_t slots = 16;
+    set->shift = 60;
+    while (slots < 2 * length) {
+        slots *= 2;
+        set->shift--;
+    }
+    set->mask = slots - 1;
+    set->keys = malloc(slots * sizeof(int));
+    if (set->keys == NULL) return -1;
+    for (size_t i = 0; i < slots; i++) set->keys[i] = -2147483647 - 1;
+    return 0;
+}
+
+
+// dedup_init() sets up a dedup_set for a list from one pass over it (length, min and max), see dedup_init_range()
+// -
+// args:
+// dedup_set *set: set to initialize
+// node *n: first node of the list
+// -
+// returns:
+// 0, or -1 if the set couldn't be allocated
+int dedup_init(dedup_set *set, node *n) {
+    memset(set, 0, sizeof(dedup_set));
+    if (n == NULL) return 0;
+    size_t length = 0;
+    int min = n->value;
+    int max = n->value;
+    for (; n != NULL; n = n->next) {
+        if (n->value < min) min = n->value;
+        if (n->value > max) max = n->value;
+        length++;
+    }
+    return dedup_init_range(set, length, min, max);
+}
+
+
+// dedup_insert() adds a value to the set
+// -
+// args:
+// dedup_set *set: the set
+// int value: value to add
+// -
+// returns:
+// 1 if the value wasn't in the set yet, 0 if it was
+int dedup_insert(dedup_set *set, int value) {
+    if (set->bits != NULL) {
+        unsigned long long bit = (unsigned long long) ((long long) value - set->min);
+        unsigned long long word = set->bits[bit / 64];
+        unsigned long long mask = 1ull << (bit % 64);
+        set->bits[bit / 64] = word | mask;
+        return (word & mask) == 0;
+    }
+    if (value == -2147483647 - 1) {
+        int fresh = !set->has_min_int;
+        set->has_min_int = 1;
+        return fresh;
+    }
+    // multiplicative (fibonacci) hash, the top bits of the product pick the slot
+    size_t i = (size_t) (((unsigned long long) (unsigned) value * 0x9E3779B97F4A7C15ull) >> set->shift);
+    while (1) {
+        int key = set->keys[i];
+        if (key == value) return 0;
+        if (key == -2147483647 - 1) {
+            set->keys[i] = value;
+            return 1;
+        }
+        i = (i + 1) & set->mask;
+    }
+}
+
+
+// dedup_free() frees whichever table the set uses
+void dedup_free(dedup_set *set) {
+    free(set->bits);
+    free(set->keys);
+}
+
+
+// unlink_batch() deletes every node keep() turns down in one sweep: survivors are relinked to each other as the
+// sweep passes them (only writing links that actually change) and the deleted nodes are chained together and
+// given back to the pool all at once at the end with pool_free_chain(), rather than one delete() and one free per
+// node. first and last are fixed up
+// -
+// args:
+// double_list *list: pointer to double_list instance
+// int (*keep)(node *, void *): called once per node in order, returns 0 if the node should be deleted
+// void *arg: passed on to keep()
+// -
+// returns:
+// the number of nodes deleted
+int unlink_batch(double_list *list, int (*keep)(node *, void *), void *arg) {
+    node *survivor = NULL;
+    node *dead_first = NULL;
+    node *dead_last = NULL;
+    int dead = 0;
+    for (node *n = list->first; n != NULL; ) {
+        node *next = n->next;
+        if (keep(n, arg)) {
+            if (n->prev != survivor) n->prev = survivor;
+            if (survivor == NULL) list->first = n;
+            else if (survivor->next != n) survivor->next = n;
+            survivor = n;
+        }
+        else {
+            if (dead_first == NULL) dead_first = n;
+            else dead_last->next = n;
+            dead_last = n;
+            dead++;
+        }
+        n = next;
+    }
+    if (survivor == NULL) list->first = NULL;
+    else survivor->next = NULL;
+    list->last = survivor;
+    pool_free_chain(dead_first, dead_last, dead, list->site);
+    return dead;
+}
+
+
+// keep() function for unlink_batch() that keeps a node only the first time its value is added to a dedup_set
+int keep_first_seen(node *n, void *seen) {
+    return dedup_insert(seen, n->value);
+}
+
+
 // delete_duplicates() deletes the duplicates in the node while maintaining the same order of elements
 // -
 // args:
 // double_list *list: pointer to double_list instance 
 // - 
 // returns:
-// nothing, it's done in place
+// 0, or -1 if there wasn't enough memory for the set of seen values (the list is left alone then)
+// -
+// a dedup_set keeps track of the values that have been seen (see dedup_init() above for how it's picked). When an
+// element "n" is encountered for the first time it's added to the set and nothing happens, else that node is
+// deleted because we've already encountered an element with the same value. This also maintains the relative order
+// of the node's elements and we don't have to sort or anything. It's done in linear time for any int values.
+// the deleting is done in one batch by unlink_batch()
+int delete_duplicates(double_list *list) {
+    dedup_set seen;
+    if (dedup_init(&seen, list->first) != 0) {
+        dedup_free(&seen);
+        return -1;
+    }
+    unlink_batch(list, keep_first_seen, &seen);
+    dedup_free(&seen);
+    return 0;
+}
+
+
+// compact_list() moves the list into one freshly allocated block with its nodes laid out in order, so walking it
+// afterwards is one sequential stream. the block is added to the node pool like a slab and the old nodes go back to
+// the pool in one chain, then pool_trim() frees every slab that's left empty, so the pool shrinks to about the
+// list's size. every node moves, first included
+// -
+// args:
+// double_list *list: pointer to double_list instance
 // -
-// an int[50] is used to keep track of the number of times each element shows up (the range of numbers in the node
-// can only be between 0-49). If, when an element "n" is encountered, arr[n] == 0 then arr[n]++ and nothing happens
-// else if an element "n" is encountered and arr[n] > 0 that node is deleted because we've already encountered an element
-// with the same value. This also maintains the relative order to the node's elements and we don't have to sort
-// or anything. It's done in linear time
-void delete_duplicates(double_list *list) {
-    int checker[RANGE + 1];
-    node *root = list->first;
-    for (int i = 0; i < RANGE + 1; i++) {
-        checker[i] = 0;
+// returns:
+// 0, or -1 if the block couldn't be allocated (the list is left alone then)
+int compact_list(double_list *list) {
+    int n = 0;
+    for (node *x = list->first; x != NULL; x = x->next) n++;
+    if (n == 0) return 0;
+    slab *block = malloc(sizeof(slab) + (size_t) n * sizeof(node));
+    if (block == NULL) return -1;
+    // goes in behind the newest slab so node_alloc() keeps bumping out of that one
+    if (pool.slabs == NULL) {
+        block->next = NULL;
+        pool.slabs = block;
+        pool.left = 0;
+    }
+    else {
+        block->next = pool.slabs->next;
+        pool.slabs->next = block;
     }
-    while (root != NULL) {
-        if (checker[root->value] == 0) checker[root->value]++;
-        else root = delete(root);
-        if (root->next == NULL) list->last = root;
-        root = root->next;
+    block->size = n;
+    node *nodes = block->nodes;
+    node *x = list->first;
+    for (int i = 0; i < n; i++, x = x->next) {
+        nodes[i].value = x->value;
+        nodes[i].prev = (i > 0) ? nodes + i - 1 : NULL;
+        nodes[i].next = (i + 1 < n) ? nodes + i + 1 : NULL;
     }
+    stats_alloc(SITE_COMPACT_LIST, sizeof(node), n);
+    pool.live += n;
+    pool_free_chain(list->first, list->last, n, list->site);
+    list->first = nodes;
+    list->last = nodes + n - 1;
+    list->site = SITE_COMPACT_LIST;
+    pool_trim();
+    return 0;
 }
 
-int main() {
+
+// table of the index of each value's first occurrence, shared by all of parallel_dedup()'s threads
+// (struct first_table typedef to first_table). like dedup_set it's either indexed directly by value - min when the
+// range is dense, or an open-addressing hash table with linear probing. a hash slot packs value and index into one
+// 64 bit word (value in the high half) so both can be claimed with a single compare-and-swap, FIRST_EMPTY marks an
+// empty slot (its index half is bigger than any real index)
+#define FIRST_EMPTY 0xFFFFFFFFFFFFFFFFull
+typedef struct first_table {
+    _Atomic unsigned *direct;            // direct[value - min] = first index (UINT_MAX if not seen yet)
+    int min;
+    _Atomic unsigned long long *slots;   // hash slots
+    size_t mask;
+    int shift;
+} first_table;
+
+
+// first_init() sizes a first_table for length values in [min, max]
+// -
+// returns:
+// 0, or -1 if it couldn't be allocated
+int first_init(first_table *t, size_t length, int min, int max) {
+    memset(t, 0, sizeof(first_table));
+    unsigned long long span = (unsigned long long) ((long long) max - min) + 1;
+    if (span <= 4 * (unsigned long long) length) {
+        t->min = min;
+        t->direct = malloc(span * sizeof(unsigned));
+        if (t->direct == NULL) return -1;
+        for (unsigned long long i = 0; i < span; i++) atomic_init(&t->direct[i], 0xFFFFFFFFu);
+        return 0;
+    }
+    size_t slots = 16;
+    t->shift = 60;
+    while (slots < 2 * length) {
+        slots *= 2;
+        t->shift--;
+    }
+    t->mask = slots - 1;
+    t->slots = malloc(slots * sizeof(unsigned long long));
+    if (t->slots == NULL) return -1;
+    for (size_t i = 0; i < slots; i++) atomic_init(&t->slots[i], FIRST_EMPTY);
+    return 0;
+}
+
+
+// first_slot() finds the slot for value in a hash first_table (its slot, or the empty slot it would go in)
+_Atomic unsigned long long* first_slot(first_table *t, int value) {
+    size_t i = (size_t) (((unsigned long long) (unsigned) value * 0x9E3779B97F4A7C15ull) >> t->shift);
+    while (1) {
+        unsigned long long slot = atomic_load_explicit(&t->slots[i], memory_order_relaxed);
+        if (slot == FIRST_EMPTY || (unsigned) (slot >> 32) == (unsigned) value) return &t->slots[i];
+        i = (i + 1) & t->mask;
+    }
+}
+
+
+// first_claim() records that value occurs at index, keeping the smallest index seen for it. threads race on it
+// with compare-and-swap, and whichever order they come in the smallest index wins
+void first_claim(first_table *t, int value, unsigned index) {
+    if (t->direct != NULL) {
+        _Atomic unsigned *cell = &t->direct[(long long) value - t->min];
+        unsigned old = atomic_load_explicit(cell, memory_order_relaxed);
+        while (index < old && !atomic_compare_exchange_weak_explicit(cell, &old, index, memory_order_relaxed,
+                                                                      memory_order_relaxed));
+        return;
+    }
+    unsigned long long mine = (unsigned long long) (unsigned) value << 32 | index;
+    _Atomic unsigned long long *cell = first_slot(t, value);
+    unsigned long long old = atomic_load_explicit(cell, memory_order_relaxed);
+    while (1) {
+        if (old == FIRST_EMPTY) {
+            if (atomic_compare_exchange_weak_explicit(cell, &old, mine, memory_order_relaxed, memory_order_relaxed)) {
+                return;
+            }
+            // someone else took the slot, it might be another value so look again
+            if (old != FIRST_EMPTY && (unsigned) (old >> 32) != (unsigned) value) {
+                cell = first_slot(t, value);
+                old = atomic_load_explicit(cell, memory_order_relaxed);
+            }
+            continue;
+        }
+        if ((unsigned) old <= index) return;
+        if (atomic_compare_exchange_weak_explicit(cell, &old, mine, memory_order_relaxed, memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+
+// first_get() returns the index of value's first occurrence (only once every first_claim() is done)
+unsigned first_get(first_table *t, int value) {
+    if (t->direct != NULL) return atomic_load_explicit(&t->direct[(long long) value - t->min], memory_order_relaxed);
+    return (unsigned) atomic_load_explicit(first_slot(t, value), memory_order_relaxed);
+}
+
+
+// one thread's share of parallel_dedup(): a segment of the list, and after the second pass its surviving nodes
+// (linked to each other but not to other segments yet) and its deleted ones (struct dedup_task typedef to dedup_task)
+typedef struct dedup_task {
+    node *first;         // first node of the segment
+    unsigned start;      // index of first in the whole list
+    unsigned count;      // nodes in the segment
+    first_table *table;
+    node *keep_first;    // survivors, NULL if none
+    node *keep_last;
+    node *dead_first;    // deleted nodes, linked through next
+    node *dead_last;
+    int dead;
+} dedup_task;
+
+
+// first pass of parallel_dedup(): claims every node's index for its value
+void* claim_worker(void *arg) {
+    dedup_task *t = arg;
+    node *n = t->first;
+    for (unsigned k = 0; k < t->count; k++, n = n->next) first_claim(t->table, n->value, t->start + k);
+    return NULL;
+}
+
+
+// second pass of parallel_dedup(): keeps the nodes that hold their value's first index and relinks them, every
+// other node goes on the segment's dead chain. only this segment's nodes are written to
+void* unlink_worker(void *arg) {
+    dedup_task *t = arg;
+    node *n = t->first;
+    node *keep = NULL;
+    t->keep_first = t->dead_first = t->dead_last = NULL;
+    t->dead = 0;
+    for (unsigned k = 0; k < t->count; k++) {
+        node *next = n->next;
+        if (first_get(t->table, n->value) == t->start + k) {
+            n->prev = keep;
+            if (keep == NULL) t->keep_first = n;
+            else keep->next = n;
+            keep = n;
+        }
+        else {
+            if (t->dead_first == NULL) t->dead_first = n;
+            else t->dead_last->next = n;
+            t->dead_last = n;
+            t->dead++;
+        }
+        n = next;
+    }
+    t->keep_last = keep;
+    return NULL;
+}
+
+
+// runs f(&tasks[i]) for i in [0, n) on n threads and waits for all of them
+void run_threads(void* (*f)(void *), dedup_task *tasks, int n) {
+    pthread_t *ids = malloc(n * sizeof(pthread_t));
+    int *started = malloc(n * sizeof(int));
+    if (ids == NULL || started == NULL) {
+        // no room to keep track of threads, do all the work on this one
+        for (int i = 0; i < n; i++) f(tasks + i);
+        free(ids);
+        free(started);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        // if a thread can't be created just do its work on this one
+        started[i] = pthread_create(ids + i, NULL, f, tasks + i) == 0;
+        if (!started[i]) f(tasks + i);
+    }
+    for (int i = 0; i < n; i++) {
+        if (started[i]) pthread_join(ids[i], NULL);
+    }
+    free(ids);
+    free(started);
+}
+
+
+// parallel_dedup() is a multithreaded delete_duplicates() with exactly the same result (same survivors in the
+// same order, same first and last). the list is cut into one segment per thread and then:
+// - every thread claims its nodes' indexes in a shared first_table, which ends up with the index of each value's
+//   first occurrence in the whole list
+// - every thread keeps the nodes that hold their value's first index and relinks them within its segment
+// - the segments are stitched together and the deleted nodes are given back to the pool one chain per segment
+// lists shorter than PARALLEL_MIN (or threads <= 1) go through delete_duplicates(), as does everything if the
+// table can't be allocated
+// -
+// args:
+// double_list *list: pointer to double_list instance
+// int threads: number of threads
+// -
+// returns:
+// 0, or -1 if there wasn't enough memory (the list is left alone then)
+int parallel_dedup(double_list *list, int threads) {
+    node *n = list->first;
+    if (n == NULL) return 0;
+    size_t length = 0;
+    int min = n->value;
+    int max = n->value;
+    for (; n != NULL; n = n->next) {
+        if (n->value < min) min = n->value;
+        if (n->value > max) max = n->value;
+        length++;
+    }
+    if (threads <= 1 || length < PARALLEL_MIN) return delete_duplicates(list);
+    if ((size_t) threads > length / (PARALLEL_MIN / 2)) threads = (int) (length / (PARALLEL_MIN / 2));
+    first_table table = {0};
+    dedup_task *tasks = malloc(threads * sizeof(dedup_task));
+    if (tasks == NULL || first_init(&table, length, min, max) != 0) {
+        free(tasks);
+        free(table.direct);
+        free(table.slots);
+        return delete_duplicates(list);
+    }
+
+    // cut the list into threads segments of (almost) equal length
+    n = list->first;
+    unsigned start = 0;
+    for (int i = 0; i < threads; i++) {
+        tasks[i].first = n;
+        tasks[i].start = start;
+        tasks[i].count = (unsigned) (length / threads + ((size_t) i < length % threads));
+        tasks[i].table = &table;
+        for (unsigned k = 0; k < tasks[i].count; k++) n = n->next;
+        start += tasks[i].count;
+    }
+    run_threads(claim_worker, tasks, threads);
+    run_threads(unlink_worker, tasks, threads);
+
+    // stitch the survivors together (the first node always survives) and free the rest
+    node *last = NULL;
+    for (int i = 0; i < threads; i++) {
+        if (tasks[i].keep_first != NULL) {
+            if (last != NULL) {
+                last->next = tasks[i].keep_first;
+                tasks[i].keep_first->prev = last;
+            }
+            last = tasks[i].keep_last;
+        }
+        pool_free_chain(tasks[i].dead_first, tasks[i].dead_last, tasks[i].dead, list->site);
+    }
+    last->next = NULL;
+    list->last = last;
+    free(tasks);
+    free(table.direct);
+    free(table.slots);
+    return 0;
+}
+
+
+// idl_init() sets up an empty index_dlist with room for cap elements (at least 1)
+// each array is one allocation as far as alloc_stats goes, growing it only changes the bytes
+void idl_init(index_dlist *l, unsigned cap, int xor_links) {
+    if (cap == 0) cap = 1;
+    l->values = my_malloc((size_t) cap * sizeof(int), SITE_INDEX_DLIST);
+    l->links = my_malloc((size_t) cap * sizeof(unsigned), SITE_INDEX_DLIST);
+    l->prevs = xor_links ? NULL : my_malloc((size_t) cap * sizeof(unsigned), SITE_INDEX_DLIST);
+    if (l->values == NULL || l->links == NULL || (!xor_links && l->prevs == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    l->cap = cap;
+    l->used = 0;
+    l->first = l->last = l->free = NIL;
+    l->length = 0;
+    l->xor_links = xor_links;
+}
+
+
+// idl_free() frees the index_dlist's arrays
+void idl_free(index_dlist *l) {
+    my_free(l->values, (size_t) l->cap * sizeof(int), SITE_INDEX_DLIST);
+    my_free(l->links, (size_t) l->cap * sizeof(unsigned), SITE_INDEX_DLIST);
+    if (l->prevs != NULL) my_free(l->prevs, (size_t) l->cap * sizeof(unsigned), SITE_INDEX_DLIST);
+}
+
+
+// idl_alloc() hands out a slot, from the free list if there is one, doubling the arrays if they're full
+unsigned idl_alloc(index_dlist *l) {
+    if (l->free != NIL) {
+        unsigned i = l->free;
+        l->free = l->links[i];
+        return i;
+    }
+    if (l->used == l->cap) {
+        unsigned cap = (l->cap < 0x80000000u) ? l->cap * 2 : NIL - 1;
+        int *values = realloc(l->values, (size_t) cap * sizeof(int));
+        if (values != NULL) l->values = values;
+        unsigned *links = realloc(l->links, (size_t) cap * sizeof(unsigned));
+        if (links != NULL) l->links = links;
+        unsigned *prevs = l->prevs;
+        if (prevs != NULL) prevs = realloc(l->prevs, (size_t) cap * sizeof(unsigned));
+        if (prevs != NULL) l->prevs = prevs;
+        if (values == NULL || links == NULL || (!l->xor_links && prevs == NULL) || l->used == cap) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        stats_resize(SITE_INDEX_DLIST, (long long) (cap - l->cap) * (sizeof(int) + sizeof(unsigned) * (l->xor_links ? 1 : 2)));
+        l->cap = cap;
+    }
+    return l->used++;
+}
+
+
+// idl_next() returns the index of the node after cur, given the node before it (only needed with xor_links)
+unsigned idl_next(index_dlist *l, unsigned cur, unsigned prev) {
+    return l->xor_links ? l->links[cur] ^ prev : l->links[cur];
+}
+
+
+// idl_append() is append() for an index_dlist: puts data at the front of the list
+void idl_append(index_dlist *l, int data) {
+    unsigned n = idl_alloc(l);
+    l->values[n] = data;
+    if (l->xor_links) {
+        l->links[n] = NIL ^ l->first;
+        if (l->first != NIL) l->links[l->first] ^= NIL ^ n;
+    }
+    else {
+        l->links[n] = l->first;
+        l->prevs[n] = NIL;
+        if (l->first != NIL) l->prevs[l->first] = n;
+    }
+    if (l->first == NIL) l->last = n;
+    l->first = n;
+    l->length++;
+}
+
+
+// idl_initialize() is initialize() for an index_dlist: builds it front to back from an array, so slots end up in
+// list order (l has to be empty)
+void idl_initialize(index_dlist *l, int (*arr)[], int size) {
+    unsigned prev = NIL;
+    for (int i = 0; i < size; i++) {
+        unsigned n = idl_alloc(l);
+        l->values[n] = (*arr)[i];
+        if (l->xor_links) {
+            l->links[n] = prev ^ NIL;
+            if (prev != NIL) l->links[prev] ^= NIL ^ n;
+        }
+        else {
+            l->links[n] = NIL;
+            l->prevs[n] = prev;
+            if (prev != NIL) l->links[prev] = n;
+        }
+        if (prev == NIL) l->first = n;
+        prev = n;
+    }
+    if (prev != NIL) l->last = prev;
+    l->length += size;
+}
+
+
+// idl_delete() is delete() for an index_dlist: unlinks cur and puts its slot on the free list
+// -
+// args:
+// index_dlist *l: the list
+// unsigned cur: node to delete
+// unsigned prev: the node before it (only needed with xor_links, otherwise it's looked up)
+// -
+// returns:
+// the index of the node that came after cur, so a walk can carry on from (prev, returned index)
+unsigned idl_delete(index_dlist *l, unsigned cur, unsigned prev) {
+    if (!l->xor_links) prev = l->prevs[cur];
+    unsigned next = idl_next(l, cur, prev);
+    if (l->xor_links) {
+        if (prev != NIL) l->links[prev] ^= cur ^ next;
+        if (next != NIL) l->links[next] ^= cur ^ prev;
+    }
+    else {
+        if (prev != NIL) l->links[prev] = next;
+        if (next != NIL) l->prevs[next] = prev;
+    }
+    if (prev == NIL) l->first = next;
+    if (next == NIL) l->last = prev;
+    l->links[cur] = l->free;
+    l->free = cur;
+    l->length--;
+    return next;
+}
+
+
+// idl_print() prints the values in the index_dlist (same format as print_node)
+void idl_print(index_dlist *l) {
+    int count = 0;
+    unsigned prev = NIL;
+    for (unsigned i = l->first; i != NIL; ) {
+        count = (count + 1) % FORMAT_COLUMNS;
+        printf("%11d, ", l->values[i]);
+        if (count == 0) printf("\n");
+        unsigned next = idl_next(l, i, prev);
+        prev = i;
+        i = next;
+    }
+    printf("\n");
+}
+
+
+// idl_delete_duplicates() is delete_duplicates() for an index_dlist, with the same dedup_set and the same result
+// -
+// returns:
+// 0, or -1 if there wasn't enough memory for the set of seen values (the list is left alone then)
+int idl_delete_duplicates(index_dlist *l) {
+    if (l->first == NIL) return 0;
+    int min = l->values[l->first];
+    int max = min;
+    unsigned prev = NIL;
+    for (unsigned i = l->first; i != NIL; ) {
+        if (l->values[i] < min) min = l->values[i];
+        if (l->values[i] > max) max = l->values[i];
+        unsigned next = idl_next(l, i, prev);
+        prev = i;
+        i = next;
+    }
+    dedup_set seen;
+    if (dedup_init_range(&seen, l->length, min, max) != 0) {
+        dedup_free(&seen);
+        return -1;
+    }
+    prev = NIL;
+    for (unsigned i = l->first; i != NIL; ) {
+        if (!dedup_insert(&seen, l->values[i])) i = idl_delete(l, i, prev);
+        else {
+            unsigned next = idl_next(l, i, prev);
+            prev = i;
+            i = next;
+        }
+    }
+    dedup_free(&seen);
+    return 0;
+}
+
+
+// idl_save() writes an index_dlist to a file: INDEX_MAGIC, the header fields (xor_links, cap, used, first, last,
+// free, length) as 32 bit ints and then the used part of values, links and (without xor_links) prevs as they are.
+// ints are in the machine's byte order
+// -
+// returns:
+// 0, or -1 if the file couldn't be written
+int idl_save(index_dlist *l, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return -1;
+    unsigned header[7] = {(unsigned) l->xor_links, l->cap, l->used, l->first, l->last, l->free, l->length};
+    int ok = fwrite(INDEX_MAGIC, 1, 4, f) == 4 && fwrite(header, sizeof(unsigned), 7, f) == 7 &&
+             fwrite(l->values, sizeof(int), l->used, f) == l->used &&
+             fwrite(l->links, sizeof(unsigned), l->used, f) == l->used &&
+             (l->xor_links || fwrite(l->prevs, sizeof(unsigned), l->used, f) == l->used);
+    if (fclose(f) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
+
+
+// idl_valid() checks that every index in an index_dlist read from a file is a slot below used or NIL, that walking
+// the list from first takes exactly length steps (following prevs back each time) and ends at last, and that the
+// free list ends without touching a slot of the list, so a corrupt or truncated file can't make a later traversal
+// or insert go out of bounds
+// -
+// returns:
+// 1 if l is consistent, 0 if it isn't (or there's no memory to check it)
+int idl_valid(index_dlist *l) {
+    unsigned used = l->used;
+    if ((l->first != NIL && l->first >= used) || (l->last != NIL && l->last >= used) ||
+        (l->free != NIL && l->free >= used) || l->length > used || (l->first == NIL) != (l->length == 0)) {
+        return 0;
+    }
+    if (!l->xor_links) {
+        for (unsigned i = 0; i < used; i++) {
+            if ((l->links[i] != NIL && l->links[i] >= used) || (l->prevs[i] != NIL && l->prevs[i] >= used)) return 0;
+        }
+    }
+    // every slot is either in the list or free, a free slot handed out while it's still in the list would leave
+    // l->free pointing wherever its link does (anything at all with xor_links)
+    unsigned char *taken = calloc(used ? used : 1, 1);
+    if (taken == NULL) return 0;
+    unsigned steps = 0;
+    unsigned prev = NIL;
+    int ok = 1;
+    for (unsigned i = l->first; ok && i != NIL; ) {
+        if (++steps > l->length || (!l->xor_links && l->prevs[i] != prev)) ok = 0;
+        else {
+            taken[i] = 1;
+            unsigned next = idl_next(l, i, prev);
+            if (next != NIL && next >= used) ok = 0;
+            prev = i;
+            i = next;
+        }
+    }
+    if (steps != l->length || prev != l->last) ok = 0;
+    for (unsigned i = l->free; ok && i != NIL; i = l->links[i]) {
+        if (i >= used || taken[i]) ok = 0;
+        else taken[i] = 1;
+    }
+    free(taken);
+    return ok;
+}
+
+
+// idl_fits() checks that the rest of f is at least bytes long, so a corrupt header can't make idl_load() allocate
+// (or read) more than the file holds
+// -
+// returns:
+// 1 if it is, 0 if it isn't or f can't be seeked
+int idl_fits(FILE *f, unsigned long long bytes) {
+    long pos = ftell(f);
+    if (pos < 0 || fseek(f, 0, SEEK_END) != 0) return 0;
+    long end = ftell(f);
+    if (end < 0 || fseek(f, pos, SEEK_SET) != 0) return 0;
+    return (unsigned long long) (end - pos) >= bytes;
+}
+
+
+// idl_load() reads an index_dlist written by idl_save() into l (which gets new arrays). the arrays are sized to the
+// used slots the file actually holds rather than the saved cap, which is only how far the saved list had grown
+// -
+// returns:
+// 0, or -1 if the file couldn't be read, isn't an index_dlist or doesn't pass idl_valid()
+int idl_load(index_dlist *l, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return -1;
+    char magic[4];
+    unsigned header[7];
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, INDEX_MAGIC, 4) != 0 ||
+        fread(header, sizeof(unsigned), 7, f) != 7 || header[2] > header[1] || header[2] == NIL ||
+        !idl_fits(f, (unsigned long long) header[2] * sizeof(unsigned) * (header[0] != 0 ? 2 : 3))) {
+        fclose(f);
+        return -1;
+    }
+    idl_init(l, header[2], header[0] != 0);
+    l->used = header[2];
+    l->first = header[3];
+    l->last = header[4];
+    l->free = header[5];
+    l->length = header[6];
+    int ok = fread(l->values, sizeof(int), l->used, f) == l->used &&
+             fread(l->links, sizeof(unsigned), l->used, f) == l->used &&
+             (l->xor_links || fread(l->prevs, sizeof(unsigned), l->used, f) == l->used) && idl_valid(l);
+    fclose(f);
+    if (!ok) idl_free(l);
+    return ok ? 0 : -1;
+}
+
+
+// seconds since some fixed point, for timing delete_duplicates()
+double now_seconds() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+// unode_alloc() allocates an empty unrolled node with my_malloc()
+unode* unode_alloc() {
+    unode *u = my_malloc(sizeof(unode), SITE_UNROLLED);
+    if (u == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    u->next = u->prev = NULL;
+    u->count = 0;
+    return u;
+}
+
+
+// unode_unlink() takes an unrolled node out of its list and frees it
+void unode_unlink(unrolled_list *list, unode *u) {
+    if (u->prev != NULL) u->prev->next = u->next;
+    else list->first = u->next;
+    if (u->next != NULL) u->next->prev = u->prev;
+    else list->last = u->prev;
+    my_free(u, sizeof(unode), SITE_UNROLLED);
+}
+
+
+// unrolled_insert() inserts a value in front of values[pos] of an unrolled node (pos == count puts it at the end)
+// a full node is split first: its upper half moves to a new node right after it
+// -
+// args:
+// unrolled_list *list: the list
+// unode *u: node to insert into, NULL (only for an empty list) makes the first node
+// int pos: position in u
+// int data: value to insert
+// -
+// returns:
+// nothing
+void unrolled_insert(unrolled_list *list, unode *u, int pos, int data) {
+    if (u == NULL) {
+        u = unode_alloc();
+        list->first = list->last = u;
+    }
+    if (u->count == UNROLLED_CAP) {
+        unode *v = unode_alloc();
+        int keep = UNROLLED_CAP / 2;
+        v->count = UNROLLED_CAP - keep;
+        memcpy(v->values, u->values + keep, v->count * sizeof(int));
+        u->count = keep;
+        v->prev = u;
+        v->next = u->next;
+        if (u->next != NULL) u->next->prev = v;
+        else list->last = v;
+        u->next = v;
+        if (pos > keep) {
+            u = v;
+            pos -= keep;
+        }
+    }
+    memmove(u->values + pos + 1, u->values + pos, (u->count - pos) * sizeof(int));
+    u->values[pos] = data;
+    u->count++;
+}
+
+
+// unrolled_append() appends an integer to the front of the unrolled list (like append() does for a double_list)
+void unrolled_append(unrolled_list *list, int data) {
+    unrolled_insert(list, list->first, 0, data);
+}
+
+
+// unrolled_initialize() makes an unrolled list from an array, filling every node but the last one up completely
+unrolled_list* unrolled_initialize(int (*arr)[], int size) {
+    unrolled_list *ret = my_malloc(sizeof(unrolled_list), SITE_UNROLLED);
+    ret->first = ret->last = NULL;
+    for (int i = 0; i < size; i++) {
+        if (ret->last == NULL || ret->last->count == UNROLLED_CAP) {
+            unode *u = unode_alloc();
+            u->prev = ret->last;
+            if (ret->last != NULL) ret->last->next = u;
+            else ret->first = u;
+            ret->last = u;
+        }
+        ret->last->values[ret->last->count++] = (*arr)[i];
+    }
+    return ret;
+}
+
+
+// unrolled_delete() deletes values[pos] of an unrolled node. a node that's left less than half full is merged
+// with the next one if they fit in one node together, and an empty node is freed
+// -
+// args:
+// unrolled_list *list: the list
+// unode *u: node holding the value
+// int pos: position of the value in u
+// -
+// returns:
+// nothing
+void unrolled_delete(unrolled_list *list, unode *u, int pos) {
+    u->count--;
+    memmove(u->values + pos, u->values + pos + 1, (u->count - pos) * sizeof(int));
+    if (u->count == 0) {
+        unode_unlink(list, u);
+        return;
+    }
+    unode *next = u->next;
+    if (u->count < UNROLLED_CAP / 2 && next != NULL && u->count + next->count <= UNROLLED_CAP) {
+        memcpy(u->values + u->count, next->values, next->count * sizeof(int));
+        u->count += next->count;
+        unode_unlink(list, next);
+    }
+}
+
+
+// print_unrolled() prints the values in the unrolled list (same format as print_node)
+void print_unrolled(unrolled_list *list) {
+    int count = 0;
+    for (unode *u = list->first; u != NULL; u = u->next) {
+        for (int i = 0; i < u->count; i++) {
+            count = (count + 1) % FORMAT_COLUMNS;
+            printf("%11d, ", u->values[i]);
+            if (count == 0) printf("\n");
+        }
+    }
+    printf("\n");
+}
+
+
+// free_unrolled() frees every node of the unrolled list and then the list itself
+void free_unrolled(unrolled_list *list) {
+    unode *u = list->first;
+    while (u != NULL) {
+        unode *temp = u;
+        u = u->next;
+        my_free(temp, sizeof(unode), SITE_UNROLLED);
+    }
+    my_free(list, sizeof(unrolled_list), SITE_UNROLLED);
+}
+
+
+// unrolled_delete_duplicates() is delete_duplicates() for an unrolled list, same dedup_set and same result
+// (first occurrences in order). rather than deleting values one at a time it compacts as it goes: survivors are
+// written to a cursor that trails the read position, so every node but the last ends up full and the leftover
+// nodes at the end are freed. the first node stays the first node
+// -
+// args:
+// unrolled_list *list: pointer to unrolled_list instance
+// -
+// returns:
+// 0, or -1 if there wasn't enough memory for the set of seen values (the list is left alone then)
+int unrolled_delete_duplicates(unrolled_list *list) {
+    if (list->first == NULL) return 0;
+    dedup_set seen;
+    size_t length = 0;
+    int min = list->first->values[0];
+    int max = min;
+    for (unode *u = list->first; u != NULL; u = u->next) {
+        for (int i = 0; i < u->count; i++) {
+            if (u->values[i] < min) min = u->values[i];
+            if (u->values[i] > max) max = u->values[i];
+        }
+        length += u->count;
+    }
+    if (dedup_init_range(&seen, length, min, max) != 0) {
+        dedup_free(&seen);
+        return -1;
+    }
+    unode *w = list->first;
+    int wi = 0;
+    for (unode *u = list->first; u != NULL; u = u->next) {
+        for (int i = 0; i < u->count; i++) {
+            int v = u->values[i];
+            if (!dedup_insert(&seen, v)) continue;
+            if (wi == UNROLLED_CAP) {
+                w->count = wi;
+                w = w->next;
+                wi = 0;
+            }
+            w->values[wi++] = v;
+        }
+    }
+    w->count = wi;
+    while (w->next != NULL) unode_unlink(list, w->next);
+    dedup_free(&seen);
+    return 0;
+}
+
+
+// unrolled_locate() finds the node holding the value at index *pos of the unrolled list and makes *pos its
+// position in that node. *pos == length gives the last node with *pos == its count (NULL for an empty list)
+unode* unrolled_locate(unrolled_list *list, int *pos) {
+    unode *u = list->first;
+    while (u != NULL && *pos >= u->count && u->next != NULL) {
+        *pos -= u->count;
+        u = u->next;
+    }
+    return u;
+}
+
+
+// unrolled_check() exercises unrolled_insert()/unrolled_delete() (node splits and merges): it builds an unrolled
+// list from the first values of arr with unrolled_append(), runs UNROLLED_EDITS inserts and deletes at random
+// positions on it and on a plain array side by side, then checks the list holds the same values and every node
+// is linked both ways with 1 to UNROLLED_CAP values
+// -
+// returns:
+// 0 if the list matched the array, 1 if it didn't (or there wasn't enough memory for the array)
+int unrolled_check(int (*arr)[], int size) {
+    int length = (size < UNROLLED_CAP * 8) ? size : UNROLLED_CAP * 8;
+    int *mirror = malloc((length + UNROLLED_EDITS) * sizeof(int));
+    if (mirror == NULL) return 1;
+    unrolled_list list = {NULL, NULL};
+    for (int i = length - 1; i >= 0; i--) unrolled_append(&list, (*arr)[i]);
+    memcpy(mirror, *arr, length * sizeof(int));
+    for (int op = 0; op < UNROLLED_EDITS; op++) {
+        if (length == 0 || rand() % 2) {
+            int pos = rand() % (length + 1);
+            int value = rand();
+            memmove(mirror + pos + 1, mirror + pos, (length - pos) * sizeof(int));
+            mirror[pos] = value;
+            length++;
+            unode *u = unrolled_locate(&list, &pos);
+            unrolled_insert(&list, u, pos, value);
+        }
+        else {
+            int pos = rand() % length;
+            memmove(mirror + pos, mirror + pos + 1, (length - pos - 1) * sizeof(int));
+            length--;
+            unode *u = unrolled_locate(&list, &pos);
+            unrolled_delete(&list, u, pos);
+        }
+    }
+    int i = 0;
+    int ok = 1;
+    unode *prev = NULL;
+    for (unode *u = list.first; u != NULL && ok; prev = u, u = u->next) {
+        ok = u->prev == prev && u->count > 0 && u->count <= UNROLLED_CAP && i + u->count <= length;
+        for (int k = 0; ok && k < u->count; k++) ok = u->values[k] == mirror[i++];
+    }
+    ok = ok && i == length && list.last == prev;
+    unode *u = list.first;
+    while (u != NULL) {
+        unode *temp = u;
+        u = u->next;
+        my_free(temp, sizeof(unode), SITE_UNROLLED);
+    }
+    free(mirror);
+    return !ok;
+}
+
+
+// index_main() is main() for the index_dlist (-i, -x for xor links): builds it from the array, deletes duplicates,
+// prints it and, if save_path isn't NULL, writes it out with idl_save() and checks it reads back the same
+int index_main(int (*arr)[], int size, int xor_links, const char *save_path) {
+    index_dlist l;
+    idl_init(&l, size, xor_links);
+    idl_initialize(&l, arr, size);
+    printf("\nindex list before deleting duplicates\n");
+    if (size > PRINT_LIMIT) printf("(%d values, not printed)\n", size);
+    else idl_print(&l);
+
+    printf("\n\nindex list after deleting duplicates\n");
+    double start = now_seconds();
+    if (idl_delete_duplicates(&l) != 0) fprintf(stderr, "not enough memory to delete duplicates\n");
+    double elapsed = now_seconds() - start;
+    if (l.length > PRINT_LIMIT) printf("(%u values, not printed)\n", l.length);
+    else idl_print(&l);
+    printf("%u duplicates deleted in %.3fs, %zu bytes per element (%s links)\n", size - l.length, elapsed,
+           sizeof(int) + (xor_links ? 1 : 2) * sizeof(unsigned), xor_links ? "xor" : "prev/next");
+    printf("-----\ndouble list info:\nhead: %11d - (index = %u)\ntail: %11d - (index = %u)\n",
+           l.values[l.first], l.first, l.values[l.last], l.last);
+    if (save_path != NULL) {
+        index_dlist copy;
+        int same = idl_save(&l, save_path) == 0 && idl_load(&copy, save_path) == 0;
+        if (same) {
+            // walk both forwards comparing values, then the copy backwards from last, which has to take length
+            // steps to get to first
+            unsigned x = l.first;
+            unsigned x_prev = NIL;
+            unsigned y = copy.first;
+            unsigned y_prev = NIL;
+            while (x != NIL && y != NIL && l.values[x] == copy.values[y]) {
+                unsigned next = idl_next(&l, x, x_prev);
+                x_prev = x;
+                x = next;
+                next = idl_next(&copy, y, y_prev);
+                y_prev = y;
+                y = next;
+            }
+            same = (x == NIL && y == NIL);
+            unsigned steps = 0;
+            unsigned y_next = NIL;
+            for (y = copy.last; y != NIL; steps++) {
+                unsigned prev = copy.xor_links ? copy.links[y] ^ y_next : copy.prevs[y];
+                y_next = y;
+                y = prev;
+            }
+            same = same && steps == copy.length && y_next == copy.first;
+            idl_free(&copy);
+        }
+        printf("saved to %s (%s)\n", save_path, same ? "reads back the same" : "FAILED");
+    }
+    idl_free(&l);
+    printf("\nmemory leaks: %lld\n\n", alloc_live());
+    return 0;
+}
+
+
+// unrolled_main() is main() for the unrolled list (-u): builds it from the array, deletes duplicates, prints and frees
+// it, then runs unrolled_check()
+int unrolled_main(int (*arr)[], int size) {
+    unrolled_list *list = unrolled_initialize(arr, size);
+    printf("\nunrolled list before deleting duplicates\n");
+    if (size > PRINT_LIMIT) printf("(%d values, not printed)\n", size);
+    else print_unrolled(list);
+
+    printf("\n\nunrolled list after deleting duplicates\n");
+    double start = now_seconds();
+    if (unrolled_delete_duplicates(list) != 0) fprintf(stderr, "not enough memory to delete duplicates\n");
+    double elapsed = now_seconds() - start;
+    int left = 0;
+    int nodes = 0;
+    for (unode *u = list->first; u != NULL; u = u->next) {
+        left += u->count;
+        nodes++;
+    }
+    if (left > PRINT_LIMIT) printf("(%d values, not printed)\n", left);
+    else print_unrolled(list);
+    printf("%d duplicates deleted in %.3fs, %d values left in %d nodes\n", size - left, elapsed, left, nodes);
+    free_unrolled(list);
+    int failed = unrolled_check(arr, size);
+    printf("%d random inserts/deletes checked against an array (%s)\n", UNROLLED_EDITS, failed ? "FAILED" : "match");
+    printf("\nmemory leaks: %lld\n\n", alloc_live());
+    return failed;
+}
+
+
+// node of a cc_list (typedef to just cc_node), next is atomic since several threads swap it with compare-and-swap
+typedef struct cc_node {
+    int value;
+    struct cc_node *_Atomic next;
+} cc_node;
+
+// concurrent list that any number of threads can push to (either end) and pop from (the front) at the same time
+// (typedef to just cc_list). it's three Treiber stacks in a row, which read front to back are:
+// - front: push_front goes on top of it, so its top is the first element
+// - middle: a batch of elements moved over from back, already in order, only ever popped
+// - back: push_back goes on top of it, so its top is the last element and it's in reverse order
+// pushes are lock-free. cc_pop() takes from front, then middle, and once both are empty swaps the whole back stack
+// out in one exchange, reverses it and makes it the new middle. that refill is done by one thread at a time
+// (refilling) and isn't lock-free: until it's installed the values it holds can't be reached, so a popper that
+// finds front and middle empty spins until the refill is done rather than reporting an empty list. popped nodes
+// are freed through hazard pointers (see cc_retire()), so a node is never freed while another thread might still
+// be reading its next pointer
+typedef struct cc_list {
+    cc_node *_Atomic front;
+    cc_node *_Atomic middle;
+    cc_node *_Atomic back;
+    atomic_int refilling;   // 1 while a popper holds the swapped out back stack
+} cc_list;
+
+// hazard pointers: the node each thread is about to read, one slot per thread (hazard_slot is this thread's). a
+// thread claims a free slot the first time it pops and gives it back when it exits, so only CC_MAX_THREADS threads
+// have to be using cc_lists at the same time, however many come and go
+cc_node *_Atomic hazards[CC_MAX_THREADS];
+atomic_int hazard_claimed[CC_MAX_THREADS];   // 1 while a thread owns the slot
+atomic_int hazard_threads = 0;               // slots ever claimed (every slot at or above it is unused)
+_Thread_local int hazard_slot = -1;
+pthread_key_t hazard_key;                    // its destructor gives a thread's slot back when the thread exits
+pthread_once_t hazard_key_once = PTHREAD_ONCE_INIT;
+// nodes each slot has popped but not freed yet. they belong to the slot rather than to a thread, so whatever a
+// thread couldn't free before it exited is freed by the next owner of its slot (or cc_reclaim())
+cc_node *retired[CC_MAX_THREADS][CC_RETIRE_BATCH + CC_MAX_THREADS];
+int retired_count[CC_MAX_THREADS];
+
+
+// cc_alloc()/cc_free() allocate and free cc_nodes, alloc_stats is updated atomically so this is fine from any thread
+cc_node* cc_alloc(int value) {
+    cc_node *n = malloc(sizeof(cc_node));
+    if (n == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    stats_alloc(SITE_CC_LIST, sizeof(cc_node), 1);
+    n->value = value;
+    atomic_init(&n->next, NULL);
+    return n;
+}
+
+void cc_free(cc_node *n) {
+    free(n);
+    stats_free(SITE_CC_LIST, sizeof(cc_node), 1);
+}
+
+
+// cc_scan() frees every retired node of a slot that isn't any thread's hazard, the caller has to own the slot
+void cc_scan(int slot) {
+    int threads = atomic_load(&hazard_threads);
+    int kept = 0;
+    for (int i = 0; i < retired_count[slot]; i++) {
+        cc_node *r = retired[slot][i];
+        int hazardous = 0;
+        for (int t = 0; t < threads && !hazardous; t++) hazardous = (atomic_load(&hazards[t]) == r);
+        if (hazardous) retired[slot][kept++] = r;
+        else cc_free(r);
+    }
+    retired_count[slot] = kept;
+}
+
+
+// cc_slot_exit() is hazard_key's destructor: frees what it can of the exiting thread's retired nodes and gives its
+// slot back
+void cc_slot_exit(void *slot_plus_one) {
+    int slot = (int) (intptr_t) slot_plus_one - 1;
+    cc_scan(slot);
+    atomic_store(&hazard_claimed[slot], 0);
+    hazard_slot = -1;
+}
+
+
+// cc_key_create() sets up hazard_key, run once through hazard_key_once
+void cc_key_create() {
+    pthread_key_create(&hazard_key, cc_slot_exit);
+}
+
+
+// cc_slot() returns this thread's hazard pointer slot, claiming a free one the first time
+int cc_slot() {
+    if (hazard_slot >= 0) return hazard_slot;
+    pthread_once(&hazard_key_once, cc_key_create);
+    for (int i = 0; i < CC_MAX_THREADS; i++) {
+        if (atomic_load(&hazard_claimed[i]) || atomic_exchange(&hazard_claimed[i], 1)) continue;
+        int threads = atomic_load(&hazard_threads);
+        while (threads <= i && !atomic_compare_exchange_weak(&hazard_threads, &threads, i + 1));
+        hazard_slot = i;
+        pthread_setspecific(hazard_key, (void *) (intptr_t) (i + 1));
+        return i;
+    }
+    fprintf(stderr, "more than %d threads using cc_lists at once\n", CC_MAX_THREADS);
+    exit(1);
+}
+
+
+// cc_reclaim() frees the retired nodes left in slots no thread owns (the ones their threads couldn't free before
+// they exited because another thread still had them as its hazard then). safe to call at any time
+void cc_reclaim() {
+    int threads = atomic_load(&hazard_threads);
+    for (int i = 0; i < threads; i++) {
+        if (atomic_load(&hazard_claimed[i]) || atomic_exchange(&hazard_claimed[i], 1)) continue;
+        cc_scan(i);
+        atomic_store(&hazard_claimed[i], 0);
+    }
+}
+
+
+// cc_init() sets up an empty cc_list
+void cc_init(cc_list *l) {
+    atomic_init(&l->front, NULL);
+    atomic_init(&l->middle, NULL);
+    atomic_init(&l->back, NULL);
+    atomic_init(&l->refilling, 0);
+}
+
+
+// stack_push() pushes a node on top of one of a cc_list's stacks (lock-free)
+void stack_push(cc_node *_Atomic *top, cc_node *n) {
+    cc_node *old = atomic_load_explicit(top, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&n->next, old, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(top, &old, n, memory_order_release, memory_order_relaxed));
+}
+
+
+// stack_pop() pops the top node off one of a cc_list's stacks (lock-free), or returns NULL if it's empty. the node
+// is published as this thread's hazard before its next pointer is read, and checked to still be on top after that,
+// so it can't have been freed (or freed and reused, which would be the ABA problem) in between
+cc_node* stack_pop(cc_node *_Atomic *top) {
+    cc_node *_Atomic *hazard = &hazards[cc_slot()];
+    cc_node *n;
+    while (1) {
+        n = atomic_load(top);
+        if (n == NULL) break;
+        atomic_store(hazard, n);
+        if (atomic_load(top) != n) continue;
+        cc_node *next = atomic_load(&n->next);
+        if (atomic_compare_exchange_strong(top, &n, next)) break;
+    }
+    atomic_store(hazard, NULL);
+    return n;
+}
+
+
+// cc_retire() hands a popped node over for freeing. every CC_RETIRE_BATCH nodes the thread frees all of its
+// retired nodes that aren't any thread's hazard with cc_scan(), the rest wait for the next round
+void cc_retire(cc_node *n) {
+    int slot = cc_slot();
+    retired[slot][retired_count[slot]++] = n;
+    if (retired_count[slot] >= CC_RETIRE_BATCH) cc_scan(slot);
+}
+
+
+// cc_push_front()/cc_push_back() put a value at either end of the list, lock-free
+void cc_push_front(cc_list *l, int value) {
+    stack_push(&l->front, cc_alloc(value));
+}
+
+void cc_push_back(cc_list *l, int value) {
+    stack_push(&l->back, cc_alloc(value));
+}
+
+
+// cc_pop() takes the first value off the list, see cc_list for how. it blocks (spins) while another thread is
+// refilling middle
+// -
+// args:
+// cc_list *l: the list
+// int *value: gets the value
+// -
+// returns:
+// 1 if a value was popped, 0 if the list was empty
+int cc_pop(cc_list *l, int *value) {
+    while (1) {
+        cc_node *n = stack_pop(&l->front);
+        if (n == NULL) n = stack_pop(&l->middle);
+        if (n != NULL) {
+            *value = n->value;
+            cc_retire(n);
+            return 1;
+        }
+        if (atomic_load(&l->back) == NULL) {
+            // a refill that's running holds the old back stack, and one that finished since middle was checked has
+            // put it in middle, so the list is only empty if neither is the case
+            if (atomic_load(&l->refilling) || atomic_load(&l->middle) != NULL) continue;
+            return 0;
+        }
+        int idle = 0;
+        if (!atomic_compare_exchange_strong(&l->refilling, &idle, 1)) continue;
+        // nobody else can touch middle (it's empty) or the swapped out stack now, so reversing it needs no atomics
+        if (atomic_load(&l->middle) == NULL) {
+            cc_node *chain = atomic_exchange(&l->back, NULL);
+            cc_node *reversed = NULL;
+            while (chain != NULL) {
+                cc_node *next = atomic_load_explicit(&chain->next, memory_order_relaxed);
+                atomic_store_explicit(&chain->next, reversed, memory_order_relaxed);
+                reversed = chain;
+                chain = next;
+            }
+            atomic_store(&l->middle, reversed);
+        }
+        atomic_store(&l->refilling, 0);
+    }
+}
+
+
+// cc_destroy() frees every node still in the list. only call it once no other thread uses this list anymore, other
+// cc_lists aren't affected (popped nodes are freed by cc_retire()/cc_reclaim(), not here)
+void cc_destroy(cc_list *l) {
+    cc_node *_Atomic *stacks[3] = {&l->front, &l->middle, &l->back};
+    for (int i = 0; i < 3; i++) {
+        cc_node *n = atomic_exchange(stacks[i], NULL);
+        while (n != NULL) {
+            cc_node *next = atomic_load(&n->next);
+            cc_free(n);
+            n = next;
+        }
+    }
+}
+
+
+// the mutex baseline cc_benchmark() compares against: a double_list with one lock around every operation
+// (typedef to just locked_list)
+typedef struct locked_list {
+    double_list list;
+    pthread_mutex_t lock;
+} locked_list;
+
+
+// locked_push() puts a value at the front (front = 1) or back of a locked_list. like cc_alloc() the node comes from
+// malloc() outside of any lock (the node pool isn't thread-safe), so cc_benchmark() compares the lists and not the
+// allocators
+void locked_push(locked_list *l, int value, int front) {
+    node *n = my_malloc(sizeof(node), SITE_LOCKED_LIST);
+    if (n == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    n->value = value;
+    pthread_mutex_lock(&l->lock);
+    if (front) {
+        n->prev = NULL;
+        n->next = l->list.first;
+        if (l->list.first != NULL) l->list.first->prev = n;
+        else l->list.last = n;
+        l->list.first = n;
+    }
+    else {
+        n->next = NULL;
+        n->prev = l->list.last;
+        if (l->list.last != NULL) l->list.last->next = n;
+        else l->list.first = n;
+        l->list.last = n;
+    }
+    pthread_mutex_unlock(&l->lock);
+}
+
+
+// locked_pop() takes the first value off a locked_list, returns 0 if it was empty
+int locked_pop(locked_list *l, int *value) {
+    pthread_mutex_lock(&l->lock);
+    node *n = l->list.first;
+    if (n != NULL) {
+        *value = n->value;
+        l->list.first = n->next;
+        if (n->next != NULL) n->next->prev = NULL;
+        else l->list.last = NULL;
+    }
+    pthread_mutex_unlock(&l->lock);
+    if (n != NULL) my_free(n, sizeof(node), SITE_LOCKED_LIST);
+    return n != NULL;
+}
+
+
+// one producer's or consumer's part of cc_stress()/cc_benchmark() (struct cc_task typedef to cc_task)
+typedef struct cc_task {
+    cc_list *cc;            // list to use, NULL to use locked instead
+    locked_list *locked;
+    int id;                 // producer number
+    int count;              // values to push (producers), 0 for a consumer
+    atomic_int *producing;  // producers still running
+    atomic_llong *popped;   // values popped by all consumers
+    unsigned char *seen;    // seen[v] counts how often value v was popped (stress test only)
+    int *last_back;         // per consumer and producer: last back-pushed sequence number seen (stress test only)
+    int producers;
+    int failed;             // a consumer saw a producer's push_back values out of order
+} cc_task;
+
+
+// producer thread: pushes id * count + i for i in [0, count), even i at the back and odd i at the front
+void* cc_producer(void *arg) {
+    cc_task *t = arg;
+    for (int i = 0; i < t->count; i++) {
+        int value = t->id * t->count + i;
+        if (t->cc != NULL) {
+            if (i % 2 == 0) cc_push_back(t->cc, value);
+            else cc_push_front(t->cc, value);
+        }
+        else locked_push(t->locked, value, i % 2);
+    }
+    atomic_fetch_sub(t->producing, 1);
+    return NULL;
+}
+
+
+// consumer thread: pops until the producers are done and the list is empty. in the stress test it also counts
+// every value and checks that each producer's push_back values come out in the order they went in
+void* cc_consumer(void *arg) {
+    cc_task *t = arg;
+    long long popped = 0;
+    while (1) {
+        int done = atomic_load(t->producing) == 0;
+        int value;
+        int got = (t->cc != NULL) ? cc_pop(t->cc, &value) : locked_pop(t->locked, &value);
+        if (!got) {
+            if (done) break;
+            continue;
+        }
+        popped++;
+        if (t->seen != NULL) {
+            __atomic_fetch_add(&t->seen[value], 1, __ATOMIC_RELAXED);
+            int producer = value / t->count;
+            int i = value % t->count;
+            if (i % 2 == 0) {
+                if (i <= t->last_back[producer]) t->failed = 1;
+                t->last_back[producer] = i;
+            }
+        }
+    }
+    atomic_fetch_add(t->popped, popped);
+    return NULL;
+}
+
+
+// cc_run() starts producers producer and consumers consumer threads on a cc_list (or a locked_list if cc is NULL),
+// each producer pushing count values, and waits for all of them
+// -
+// returns:
+// seconds it took, or -1 if a consumer found values out of order or the wrong number of values was popped
+double cc_run(cc_list *cc, locked_list *locked, int producers, int consumers, int count, unsigned char *seen) {
+    int threads = producers + consumers;
+    cc_task *tasks = calloc(threads, sizeof(cc_task));
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    int *last_back = malloc((size_t) consumers * producers * sizeof(int));
+    if (tasks == NULL || ids == NULL || last_back == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < consumers * producers; i++) last_back[i] = -1;
+    atomic_int producing;
+    atomic_llong popped;
+    atomic_init(&producing, producers);
+    atomic_init(&popped, 0);
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        tasks[i] = (cc_task) {cc, locked, i, count, &producing, &popped, seen, NULL, producers, 0};
+        if (i >= producers) tasks[i].last_back = last_back + (size_t) (i - producers) * producers;
+        if (pthread_create(ids + i, NULL, (i < producers) ? cc_producer : cc_consumer, tasks + i) != 0) {
+            fprintf(stderr, "could not start thread %d\n", i);
+            exit(1);
+        }
+    }
+    int failed = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        failed |= tasks[i].failed;
+    }
+    double elapsed = now_seconds() - start;
+    if (atomic_load(&popped) != (long long) producers * count) failed = 1;
+    free(tasks);
+    free(ids);
+    free(last_back);
+    return failed ? -1 : elapsed;
+}
+
+
+// cc_stress() hammers a cc_list with threads producers and threads consumers pushing and popping count values each,
+// then checks that every value was popped exactly once, that each producer's push_back values were popped in
+// order, and that every node was freed
+// -
+// returns:
+// 0 if everything checked out, 1 otherwise
+int cc_stress(int threads, int count) {
+    if (2 * threads > CC_MAX_THREADS) threads = CC_MAX_THREADS / 2;
+    unsigned char *seen = calloc((size_t) threads * count, 1);
+    if (seen == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    long long before = alloc_live();
+    cc_list l;
+    cc_init(&l);
+    double elapsed = cc_run(&l, NULL, threads, threads, count, seen);
+    cc_destroy(&l);
+    // the consumers have exited, so every node they retired can be freed now
+    cc_reclaim();
+    long long wrong = 0;
+    for (long long v = 0; v < (long long) threads * count; v++) wrong += (seen[v] != 1);
+    free(seen);
+    long long leaked = alloc_live() - before;
+    int ok = elapsed >= 0 && wrong == 0 && leaked == 0;
+    printf("stress test: %d producers, %d consumers, %d values each: %s (%lld values popped the wrong number of "
+           "times, %lld nodes leaked)\n", threads, threads, count, ok ? "passed" : "FAILED", wrong, leaked);
+    return !ok;
+}
+
+
+// cc_benchmark() times the cc_list against the locked_list with 1, 2, 4, ... up to threads producers (and as many
+// consumers), each producer pushing count values, and prints millions of push+pop pairs per second
+int cc_benchmark(int threads, int count) {
+    if (2 * threads > CC_MAX_THREADS) threads = CC_MAX_THREADS / 2;
+    printf("%10s %14s %14s   (million push+pop per second)\n", "producers", "cc_list", "mutex");
+    for (int p = 1; p <= threads; p *= 2) {
+        cc_list l;
+        cc_init(&l);
+        double cc_time = cc_run(&l, NULL, p, p, count, NULL);
+        cc_destroy(&l);
+        cc_reclaim();
+        locked_list locked = {{NULL, NULL, SITE_LOCKED_LIST}, PTHREAD_MUTEX_INITIALIZER};
+        double locked_time = cc_run(NULL, &locked, p, p, count, NULL);
+        pthread_mutex_destroy(&locked.lock);
+        if (cc_time < 0 || locked_time < 0) {
+            fprintf(stderr, "a run lost values\n");
+            return 1;
+        }
+        double pairs = (double) p * count / 1e6;
+        printf("%10d %14.2f %14.2f\n", p, pairs / cc_time, pairs / locked_time);
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    // usage: double_list [-n size] [-r range | -w] [-c] [-p threads | -u | -i [-x] [-I file]]
+    //        double_list -S threads [-n count]
+    //        double_list -T threads [-n count]
+    //        any of them [-A file]
+    // (build with alloc_stats.c and -pthread, add -DALLOC_STATS=0 to compile the allocation counters out)
+    // -n sets the number of elements in the list (default ARR_SIZE)
+    // -r sets the range of the random values, [0-range] inclusive (default RANGE)
+    // -w uses random values from the whole int range instead, negative ones included
+    // -p deletes duplicates on that many threads with parallel_dedup() (0 = one per core)
+    // -c compacts the list with compact_list() after deleting duplicates (this moves the head too)
+    // -u uses an unrolled list (UNROLLED_CAP values per node) instead, see unrolled_main()
+    // -i uses an index_dlist (32 bit index links in arrays) instead, see index_main(). -x makes it use xor links,
+    //    -I also saves it to file and reads it back
+    // -S runs cc_stress() on the concurrent cc_list with that many producers and consumers, -n values per producer
+    //    (default 1000000)
+    // -T runs cc_benchmark() (cc_list against a mutex around a double_list) up to that many producers/consumers
+    // -A writes an alloc_stats snapshot (JSON) to file when the program exits, "-" for stdout
+    // lists longer than PRINT_LIMIT aren't printed
+    int size = ARR_SIZE;
+    int range = RANGE;
+    int wide = 0;
+    int threads = -1;
+    int unrolled = 0;
+    int compact = 0;
+    int use_index = 0;
+    int xor_links = 0;
+    const char *index_path = NULL;
+    int stress = 0;
+    int benchmark = 0;
+    int size_given = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+            size_given = 1;
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) range = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0) wide = 1;
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-u") == 0) unrolled = 1;
+        else if (strcmp(argv[i], "-c") == 0) compact = 1;
+        else if (strcmp(argv[i], "-i") == 0) use_index = 1;
+        else if (strcmp(argv[i], "-x") == 0) xor_links = 1;
+        else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc) index_path = argv[++i];
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) stress = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) benchmark = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-A") == 0 && i + 1 < argc) stats_path = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [-n size] [-r range | -w] [-c] [-p threads | -u | -i [-x] [-I file]]\n"
+                            "       %s -S threads [-n count]\n"
+                            "       %s -T threads [-n count]\n"
+                            "       any of them [-A file]\n", argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (size < 1 || range < 0) {
+        fprintf(stderr, "size has to be at least 1 and range can't be negative\n");
+        return 1;
+    }
+    if (threads == 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    alloc_stats_sites(site_names, SITES);
+    atexit(dump_stats_at_exit);
+    if (stress > 0 || benchmark > 0) {
+        int count = size_given ? size : 1000000;
+        int status = (stress > 0) ? cc_stress(stress, count) : cc_benchmark(benchmark, count);
+        pool_release();
+        printf("\nmemory leaks: %lld\n\n", alloc_live());
+        return status;
+    }
+
     // initialize random seed so that random numbers are different every time you run main()
-    // and initialize array of randomly generated numbers between 0-ARR_SIZE (inclusive) to be turned into a doubly-linked
-    // node
+    // and initialize array of randomly generated numbers between 0-range (inclusive) to be turned into a doubly-linked
+    // node (on the heap since size can be huge)
     srand((unsigned)(time(NULL)));
-    int arr[ARR_SIZE];
-    for (int i = 0; i < ARR_SIZE; i++) {
-        arr[i] = rand() % (RANGE + 1);
+    int (*arr)[] = malloc(sizeof(int) * (size_t) size);
+    if (arr == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < size; i++) {
+        if (wide) (*arr)[i] = (int) (((unsigned) rand() << 16) ^ (unsigned) rand());
+        else (*arr)[i] = rand() % (range + 1);
+    }
+
+    if (unrolled || use_index) {
+        int status = unrolled ? unrolled_main(arr, size) : index_main(arr, size, xor_links, index_path);
+        free(arr);
+        return status;
     }
 
     // create doubly linked_node from array
-    int size = sizeof(arr) / sizeof(arr[0]);
-    double_list *list= initialize(&arr, size);
+    double_list *list= initialize(arr, size);
+    free(arr);
     
     // print node before and after deleting duplicates 
     // (if VERBOSE_PRINT is true then a more in-depth printing of the node will be done, else just the values will
     // be printed) see line 8
     printf("\nlist before deleting duplicates\n");
-    if (VERBOSE_PRINT) print_node_full(list->first);
+    if (size > PRINT_LIMIT) printf("(%d nodes, not printed)\n", size);
+    else if (VERBOSE_PRINT) print_node_full(list->first);
     else print_node(list->first);
     // print the head and tail node of the doubly linked list (these should correspond to the first/last numbers shown
     // the head address should be the exact same even after delete_duplicates
@@ -200,16 +2031,30 @@ int main() {
     printf("-----\ndouble list info:\nhead: %11d - (address = %p)\ntail: %11d - (address = %p)\n", list->first->value, (void *) list->first, list->last->value, (void *) list->last);
 
     printf("\n\nlist after deleting duplicates\n");
-    delete_duplicates(list);
-    if (VERBOSE_PRINT) print_node_full(list->first);
+    double start = now_seconds();
+    if ((threads > 0 ? parallel_dedup(list, threads) : delete_duplicates(list)) != 0) fprintf(stderr, "not enough memory to delete duplicates\n");
+    double elapsed = now_seconds() - start;
+    double compact_elapsed = 0;
+    if (compact) {
+        start = now_seconds();
+        if (compact_list(list) != 0) fprintf(stderr, "not enough memory to compact the list\n");
+        compact_elapsed = now_seconds() - start;
+    }
+    int left = 0;
+    for (node *n = list->first; n != NULL; n = n->next) left++;
+    if (left > PRINT_LIMIT) printf("(%d nodes, not printed)\n", left);
+    else if (VERBOSE_PRINT) print_node_full(list->first);
     else print_node(list->first);
+    printf("%d duplicates deleted in %.3fs\n", size - left, elapsed);
+    if (compact) printf("compacted in %.3fs (so the head's address changed too)\n", compact_elapsed);
     printf("-----\ndouble list info:\nhead: %11d - (address = %p)\ntail: %11d - (address = %p)\n", list->first->value, (void *) list->first, list->last->value, (void *) list->last);
     printf("tail's address SHOULD change if it's value changes and it's value should exactly match the last element in the list\n");
-    printf("head's address should never change\n");
+    if (!compact) printf("head's address should never change\n");
     
-    // recursively free all items in doubly linked list
+    // hand the deduplicated list back, then give the (now empty) slabs back in one go with pool_release()
     free_list(list);
-    printf("\nmemory leaks: %d\n\n", malloc_num);
+    int leaked = pool_release();
+    printf("\n%d nodes still in the pool (should be 0)\nmemory leaks: %lld\n\n", leaked, alloc_live());
     return 0;
 }
 
@@ -1,12 +1,49 @@
+#define _POSIX_C_SOURCE 200809L // pread() and off_t for external_sort(), strict -std=c11 builds don't declare them
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>  
+#include <pthread.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+#include <unistd.h>
+#include "alloc_stats.h"
 
 #define ARR_SIZE 100 // used to set the size of the linked list
 #define RANGE 100    // used to determine the range of numbers that should be in linked list [0-RANGE] inclusive
+#define SLAB_NODES 65536 // number of list nodes carved out of each slab of the node pool
+#define SORT_BINS 64     // number of run bins in list_sort(), bin i holds a run of 2^i nodes so 64 covers any list
+#define PRINT_LIMIT 1000 // lists longer than this aren't printed
+#define PARALLEL_MIN 65536 // lists shorter than this aren't worth splitting across threads in parallel_sort()
+#define COUNTING_MAX 65536 // value ranges up to this size get one bucket per value in radix_sort()
+#define RADIX_BITS 11      // widest digit radix_sort() uses on wider ranges (2^11 buckets)
+#define MIN_RUN 32         // natural_sort() extends runs shorter than this with insertion sort
+#define MAX_RUNS 128       // size of natural_sort()'s run stack, the merge rules keep it logarithmic in n
+#define NETWORK_GROUP 64   // array_sort() sorts blocks of 8 values, 8 blocks at a time (one per vector lane)
+#define HYBRID_NEARLY_SORTED 64 // hybrid_sort() uses natural_sort() if at most 1 in this many pairs is out of order
+#define HYBRID_SHORT 1024       // hybrid_sort() relinks lists shorter than this with list_sort()
+#define READ_BUF 65536          // bytes external_sort() reads its text input in
+#define MERGE_BUF_MIN 65536     // smallest buffer (bytes) external_sort() gives each run when merging, which caps
+                                // how many runs one merge pass can take
+#define EXT_MIN_BUDGET (1 << 20) // smallest memory budget external_sort() accepts (bytes)
+#define NIL 0xFFFFFFFFu          // "NULL" index in an index_list
+#define INDEX_MAGIC "ILS1"       // first 4 bytes of a file written by ilist_save()
 
-// sanity checker to make sure malloc() and free() are called the same number of times
-int malloc_num = 0;
+
+// places allocations are counted under in alloc_stats (typedef to just alloc_site)
+
+typedef enum alloc_site {
+    SITE_APPEND,         // append(), so fromarray() too
+    SITE_LIST_D_COPY,    // list_d_copy()
+    SITE_MERGE,          // merge()'s copy of the list (msort() makes one per merge)
+    SITE_LIST_COPY,      // list_copy() compacting a list into one block
+    SITE_EXTERNAL_SORT,  // external_sort() loading its output into a list
+    SITE_INDEX_LIST,     // index_list arrays
+    SITES
+} alloc_site;
+
+const char *site_names[SITES] = {"append", "list_d_copy", "merge", "list_copy", "external_sort", "index_list"};
 
 
 // linked list struct (typedef'd to just list)
@@ -34,21 +71,106 @@ void print_list(list *head) {
 }
 
 
-// personalmalloc() function - calls malloc() and then INCREMENT the global variable malloc_num
+// personalmalloc() function - calls malloc() and then counts the allocation under site in alloc_stats (if it worked)
 // I did this because my code always leaks if I don't
 
-void* my_malloc(int size) {
+void* my_malloc(size_t size, alloc_site site) {
     void* ret = malloc(size);
-    malloc_num++;
+    if (ret != NULL) stats_alloc(site, size, 1);
     return ret;
 }
 
 
-// personal free() function - calls free() and then DECREMENTS the global variable malloc_num
+// personal free() function - calls free() and then counts the free in alloc_stats (size and site are what it was
+// allocated with)
 
-void my_free(void* val) {
+void my_free(void* val, size_t size, alloc_site site) {
     free(val);
-    malloc_num--;
+    stats_free(site, size, 1);
+}
+
+
+// slab of list nodes handed out by the node pool (typedef to just slab)
+// slabs are chained together through next so the whole pool can be given back in one go. they're normally
+// SLAB_NODES nodes long, but list_copy() also adds blocks sized to the list it copies
+
+typedef struct slab {
+    struct slab *next;
+    list nodes[];
+} slab;
+
+
+// node pool - instead of one malloc() per node, nodes are bumped out of big slabs and freed nodes are pushed
+// onto an intrusive free list threaded through their own next pointers (typedef to just node_pool)
+// nodes are bumped from the top of a slab downwards: append() pushes to the front, so a list built by fromarray()
+// ends up running forwards through memory
+
+typedef struct node_pool {
+    slab *slabs;     // newest slab first
+    int left;        // nodes not yet bumped out of the newest slab
+    list *free;      // recycled nodes
+    int live;        // nodes currently handed out
+} node_pool;
+
+node_pool pool = {NULL, 0, NULL, 0};
+
+
+// bottom function hands out a node from the pool, it counts as one allocation under site in alloc_stats
+// -
+// returns:
+// pointer to an uninitialized list node
+
+list* node_alloc(alloc_site site) {
+    list *n;
+    stats_alloc(site, sizeof(list), 1);
+    pool.live++;
+    if (pool.free != NULL) {
+        n = pool.free;
+        pool.free = n->next;
+        return n;
+    }
+    if (pool.left == 0) {
+        slab *s = malloc(sizeof(slab) + SLAB_NODES * sizeof(list));
+        if (s == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        s->next = pool.slabs;
+        pool.slabs = s;
+        pool.left = SLAB_NODES;
+    }
+    return &pool.slabs->nodes[--pool.left];
+}
+
+
+// gives a node back to the pool (pushes it onto the free list) and counts it as freed at site (where it was
+// allocated)
+
+void node_free(list *n, alloc_site site) {
+    n->next = pool.free;
+    pool.free = n;
+    stats_free(site, sizeof(list), 1);
+    pool.live--;
+}
+
+
+// bulk free - gives every slab back with free() in O(slabs). lists should be handed back with free_list() first:
+// nodes still handed out when it's called are leaks, so they're left counted as live in alloc_stats
+// -
+// returns:
+// the number of nodes that were still handed out (leaked)
+
+int pool_release() {
+    int leaked = pool.live;
+    while (pool.slabs != NULL) {
+        slab *s = pool.slabs;
+        pool.slabs = s->next;
+        free(s);
+    }
+    pool.left = 0;
+    pool.free = NULL;
+    pool.live = 0;
+    return leaked;
 }
 
 
@@ -77,7 +199,7 @@ void make_list(list *head, int data) {
 // appended list instance
 
 list* append(list *h, int data) {
-    list* head = my_malloc(sizeof(list));
+    list* head = node_alloc(SITE_APPEND);
     make_list(head, data);
     head->next = h;
     return head;
@@ -104,37 +226,86 @@ list* fromarray(list *head, int (*arr)[], int size) {
 
 
 // deep copies the list (creates a list with the same values but the memory addresses of each element is 
-// completely different
+// completely different). it's a loop that keeps a pointer to the copy's tail, so long lists can't overflow the stack
+// with compact set the copy is also a compaction: the list is counted first and all of its nodes come out of one
+// block, laid out in the order they're linked, so the copy is written (and later read) as one sequential stream.
+// the block is added to the node pool like a slab, so its nodes go through node_free()/pool_release() like any
+// others
 // -
 // args:
 // list *head: root node of linked list to be copied
+// int compact: 1 to lay the copy out in one block in traversal order, 0 to take nodes from the pool one by one
+// alloc_site site: what the copy's nodes are counted as in alloc_stats (compacting always counts as SITE_LIST_COPY)
 // -
 // returns:
 // deep copied linked list
 
-list* list_d_copy(list *head) {
+list* list_copy(list *head, int compact, alloc_site site) {
     if (head == NULL) return head;
-    list *copy = my_malloc(sizeof(list));
-    copy->value = head->value;
-    copy->next = list_d_copy(head->next);
-    return copy;
+    list first;
+    list *tail = &first;
+    if (!compact) {
+        for (; head != NULL; head = head->next) {
+            list *copy = node_alloc(site);
+            copy->value = head->value;
+            tail->next = copy;
+            tail = copy;
+        }
+        tail->next = NULL;
+        return first.next;
+    }
+
+    int n = 0;
+    for (list *l = head; l != NULL; l = l->next) n++;
+    slab *block = malloc(sizeof(slab) + (size_t) n * sizeof(list));
+    if (block == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    // goes in behind the newest slab so node_alloc() keeps bumping out of that one
+    if (pool.slabs == NULL) {
+        block->next = NULL;
+        pool.slabs = block;
+        pool.left = 0;
+    }
+    else {
+        block->next = pool.slabs->next;
+        pool.slabs->next = block;
+    }
+    list *nodes = block->nodes;
+    for (int i = 0; i < n; i++, head = head->next) {
+        nodes[i].value = head->value;
+        nodes[i].next = nodes + i + 1;
+    }
+    nodes[n - 1].next = NULL;
+    stats_alloc(SITE_LIST_COPY, sizeof(list), n);
+    pool.live += n;
+    return nodes;
 }
 
 
-// recursively frees elements in a linked list and uses the my_free() function above (see line 47) to keep
-// track of the number of times free() is called
+// deep copy with nodes taken from the pool, see list_copy()
+
+list* list_d_copy(list *head) {
+    return list_copy(head, 0, SITE_LIST_D_COPY);
+}
+
+
+// frees elements in a linked list by handing them back to the node pool with node_free() (see above), which counts
+// the frees in alloc_stats
 // -
 // args:
 // list *head: root node of the linked list to be deleted
+// alloc_site site: where the list's nodes were allocated (the sorts relink nodes, so a sorted list keeps its site)
 // -
 // returns:
 // nothing
 
-void free_list(list *head) {
+void free_list(list *head, alloc_site site) {
     while (head != NULL) {
         list *temp = head;
         head = head->next;
-        my_free(temp);
+        node_free(temp, site);
     }
 }
 
@@ -146,15 +317,16 @@ void free_list(list *head) {
 // list *head: root node of linked list
 // lo: beginning of first portion of head that's sorted
 // hi: end of second portion of head that's sorted
+// site: where head's nodes were allocated, set to SITE_MERGE for the returned copy
 // -
 // returns:
 // a new list instance where the internally sorted portions have been merged. This is done out-of-place so a new 
 // head instance is returned and the previous one is freed using free_list (see line 131)
 
-list* merge(list *head, int lo, int hi) {
+list* merge(list *head, int lo, int hi, alloc_site *site) {
     list *head_lo;
     list *head_hi;
-    list *aux = list_d_copy(head);
+    list *aux = list_copy(head, 0, SITE_MERGE);
     list *aux_copy = aux;
     list *head_freer = head;
 
@@ -200,7 +372,8 @@ list* merge(list *head, int lo, int hi) {
         }
         aux = aux->next;
     }
-    free_list(head_freer);
+    free_list(head_freer, *site);
+    *site = SITE_MERGE;
     return head;
 }
 
@@ -213,51 +386,1580 @@ list* merge(list *head, int lo, int hi) {
 // list *head: root node of linked list to be sorted
 // int lo: lower bound of portion of array to be sorted (starts at 0)
 // int hi: upper bound of portion of array to be sorted (starts as the length of head)
+// alloc_site *site: where head's nodes were allocated, updated as merge() replaces the list
 // -
 // returns:
 // root node of sorted array
 
-list* msort(list *head, int lo, int hi) {
+list* msort(list *head, int lo, int hi, alloc_site *site) {
     if (lo >= hi) return head;
     int mid = hi - (hi - lo) / 2;
 
-    head = msort(head, lo, mid-1);
-    head = msort(head, mid, hi);    
+    head = msort(head, lo, mid-1, site);
+    head = msort(head, mid, hi, site);    
+
+    return merge(head, lo, hi, site);
+}
+
+
+// seconds since some fixed point, for timing the sorts
+
+double now_seconds() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+// bottom function merges two sorted lists into one by relinking their next pointers, nothing is allocated or copied
+// ties are taken from a first, so if a's nodes came before b's the merge is stable
+// -
+// args:
+// list *a: root node of the first sorted list
+// list *b: root node of the second sorted list
+// -
+// returns:
+// root node of the merged list
+
+list* merge_sorted(list *a, list *b) {
+    list head;
+    list *tail = &head;
+    while (a != NULL && b != NULL) {
+        if (b->value < a->value) {
+            tail->next = b;
+            tail = b;
+            b = b->next;
+        }
+        else {
+            tail->next = a;
+            tail = a;
+            a = a->next;
+        }
+    }
+    tail->next = (a != NULL) ? a : b;
+    return head.next;
+}
+
+
+// bottom-up merge sort that only relinks next pointers - no allocations, no indexes and no recursion
+// nodes are taken off the front one at a time and carried up through bins like a binary counter: bins[i] is either
+// empty or a sorted run of 2^i nodes, and a new run is merged with every full bin below the first empty one.
+// bins always hold nodes that came before the run they're merged with so the sort is stable. O(n log n) with
+// 64 pointers of extra space
+// -
+// args:
+// list *head: root node of linked list to be sorted
+// -
+// returns:
+// root node of the sorted list
+
+list* list_sort(list *head) {
+    list *bins[SORT_BINS];
+    int used = 0;
+    while (head != NULL) {
+        list *run = head;
+        head = head->next;
+        run->next = NULL;
+        int i = 0;
+        for (; i < used && bins[i] != NULL; i++) {
+            run = merge_sorted(bins[i], run);
+            bins[i] = NULL;
+        }
+        bins[i] = run;
+        if (i == used) used++;
+    }
+    // higher bins hold earlier nodes, so fold them in from the bottom up
+    list *sorted = NULL;
+    for (int i = 0; i < used; i++) {
+        if (bins[i] != NULL) sorted = merge_sorted(bins[i], sorted);
+    }
+    return sorted;
+}
+
+
+// one thread's share of parallel_sort(): a segment of the list, sorted in place by sort_worker() and then
+// merged with other segments by merge_worker() (struct sort_task typedef to sort_task)
+
+typedef struct sort_task {
+    list *head;   // root node of the segment (NULL terminated)
+    int partner;  // offset to the task this one absorbs in merge_worker()
+} sort_task;
+
+
+// sorts one segment with list_sort()
+
+void* sort_worker(void *arg) {
+    sort_task *t = arg;
+    t->head = list_sort(t->head);
+    return NULL;
+}
+
+
+// merges the segment of the task partner places later into this one, this segment came first so ties stay stable
+
+void* merge_worker(void *arg) {
+    sort_task *t = arg;
+    sort_task *other = t + t->partner;
+    t->head = merge_sorted(t->head, other->head);
+    other->head = NULL;
+    return NULL;
+}
+
+
+// runs f(&tasks[i * stride]) for i in [0, n) on n threads and waits for all of them
+
+void run_threads(void* (*f)(void *), sort_task *tasks, int n, int stride) {
+    pthread_t *ids = malloc(n * sizeof(pthread_t));
+    int *started = malloc(n * sizeof(int));
+    if (ids == NULL || started == NULL) {
+        // no room to keep track of threads, do all the work on this one
+        for (int i = 0; i < n; i++) f(tasks + (size_t) i * stride);
+        free(ids);
+        free(started);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        // if a thread can't be created just do its work on this one
+        started[i] = pthread_create(ids + i, NULL, f, tasks + (size_t) i * stride) == 0;
+        if (!started[i]) f(tasks + (size_t) i * stride);
+    }
+    for (int i = 0; i < n; i++) {
+        if (started[i]) pthread_join(ids[i], NULL);
+    }
+    free(ids);
+    free(started);
+}
+
+
+// multithreaded list_sort(): cuts the list into one segment per thread, sorts the segments concurrently and then
+// merges them pairwise in a tree (log2(threads) levels, each level's merges running in parallel). stable like
+// list_sort(), and lists shorter than PARALLEL_MIN (or threads <= 1) just go through list_sort(), as does everything
+// if the tasks can't be allocated
+// -
+// args:
+// list *head: root node of linked list to be sorted
+// int threads: number of threads to sort on
+// -
+// returns:
+// root node of the sorted list
+
+list* parallel_sort(list *head, int threads) {
+    long long n = 0;
+    for (list *l = head; l != NULL; l = l->next) n++;
+    if (threads <= 1 || n < PARALLEL_MIN) return list_sort(head);
+    if (threads > n / (PARALLEL_MIN / 2)) threads = (int) (n / (PARALLEL_MIN / 2));
+
+    // cut the list into threads segments of (almost) equal length
+    sort_task *tasks = malloc(threads * sizeof(sort_task));
+    if (tasks == NULL) return list_sort(head);
+    for (int i = 0; i < threads; i++) {
+        long long len = n / threads + (i < n % threads);
+        tasks[i].head = head;
+        for (long long k = 1; k < len; k++) head = head->next;
+        list *next = head->next;
+        head->next = NULL;
+        head = next;
+    }
+    run_threads(sort_worker, tasks, threads, 1);
+
+    // tree merge: at each level task i absorbs task i + step
+    for (int step = 1; step < threads; step *= 2) {
+        int pairs = 0;
+        for (int i = 0; i + step < threads; i += 2 * step) {
+            tasks[i].partner = step;
+            pairs++;
+        }
+        run_threads(merge_worker, tasks, pairs, 2 * step);
+    }
+    head = tasks[0].head;
+    free(tasks);
+    return head;
+}
+
+
+// bottom function deals the nodes of a list into buckets by (value - min) >> shift & mask, appending at each bucket's
+// tail so nodes keep their order within a bucket, then stitches the buckets back together in order
+// -
+// args:
+// list *head: root node of the list
+// int min: smallest value in the list
+// int shift, mask: which digit of (value - min) picks the bucket
+// list **heads, **tails: mask + 1 bucket heads and tails, heads have to be all NULL and are left that way
+// -
+// returns:
+// root node of the relinked list
+
+list* bucket_pass(list *head, int min, int shift, unsigned mask, list **heads, list **tails) {
+    while (head != NULL) {
+        unsigned b = ((unsigned) head->value - (unsigned) min) >> shift & mask;
+        if (heads[b] == NULL) heads[b] = head;
+        else tails[b]->next = head;
+        tails[b] = head;
+        head = head->next;
+    }
+    list *first = NULL;
+    list *tail = NULL;
+    for (unsigned b = 0; b <= mask; b++) {
+        if (heads[b] == NULL) continue;
+        if (first == NULL) first = heads[b];
+        else tail->next = heads[b];
+        tail = tails[b];
+        heads[b] = NULL;
+    }
+    if (tail != NULL) tail->next = NULL;
+    return first;
+}
+
+
+// non-comparison sort for integer lists, O(n) for a fixed key width and stable. one pass finds the value range:
+// - a range of at most COUNTING_MAX values gets one bucket per value, so a single bucket_pass() sorts the list
+// - wider ranges get an LSD radix sort on (value - min), with as few passes of at most RADIX_BITS bits as cover the
+//   range (so at most 3 passes for any int)
+// only the bucket arrays are allocated, nodes are relinked and never copied
+// -
+// args:
+// list *head: root node of linked list to be sorted
+// -
+// returns:
+// root node of the sorted list
+
+list* radix_sort(list *head) {
+    if (head == NULL) return head;
+    int min = head->value;
+    int max = head->value;
+    for (list *l = head->next; l != NULL; l = l->next) {
+        if (l->value < min) min = l->value;
+        if (l->value > max) max = l->value;
+    }
+    unsigned span = (unsigned) max - (unsigned) min;
+    int bits = 0;
+    while (bits < 32 && (span >> bits) != 0) bits++;
+    if (bits == 0) return head;
+
+    int digit;
+    int passes;
+    if (span < COUNTING_MAX) {
+        digit = bits;
+        passes = 1;
+    }
+    else {
+        passes = (bits + RADIX_BITS - 1) / RADIX_BITS;
+        digit = (bits + passes - 1) / passes;
+    }
+    unsigned mask = (1u << digit) - 1;
+    list **heads = calloc((size_t) mask + 1, sizeof(list*));
+    list **tails = malloc(((size_t) mask + 1) * sizeof(list*));
+    if (heads == NULL || tails == NULL) {
+        // no room for buckets, fall back to the comparison sort
+        free(heads);
+        free(tails);
+        return list_sort(head);
+    }
+    for (int p = 0; p < passes; p++) {
+        head = bucket_pass(head, min, p * digit, mask, heads, tails);
+    }
+    free(heads);
+    free(tails);
+    return head;
+}
+
+
+// a sorted run of nodes in natural_sort(), detached from the rest of the list (struct run typedef to run)
+
+typedef struct run {
+    list *head;
+    list *tail;
+    long long len;
+} run;
+
+
+// merges run b (which came later in the list) into run a, stable
+// if a already ends before b starts the two are just joined in O(1). otherwise it's a galloping merge: a linked
+// list can't binary search, but it doesn't need to move anything either while one side keeps winning, so the
+// pointers only race along and a link is only written when the winning side switches
+// -
+// args:
+// run *a: first run, gets the merged run
+// run *b: second run
+// -
+// returns:
+// nothing, a is updated
+
+void merge_runs(run *a, run *b) {
+    if (a->tail->value <= b->head->value) {
+        a->tail->next = b->head;
+        a->tail = b->tail;
+        a->len += b->len;
+        return;
+    }
+    list head;
+    list *tail = &head;
+    list *x = a->head;
+    list *y = b->head;
+    while (1) {
+        if (y->value < x->value) {
+            tail->next = y;
+            do {
+                tail = y;
+                y = y->next;
+            } while (y != NULL && y->value < x->value);
+            if (y == NULL) {
+                tail->next = x;
+                break;
+            }
+        }
+        else {
+            tail->next = x;
+            do {
+                tail = x;
+                x = x->next;
+            } while (x != NULL && x->value <= y->value);
+            if (x == NULL) {
+                tail->next = y;
+                a->tail = b->tail;
+                break;
+            }
+        }
+    }
+    a->head = head.next;
+    a->len += b->len;
+}
+
+
+// bottom function cuts the next natural run off the front of a list: a non-decreasing run is taken as it is and a
+// strictly decreasing one is reversed in place (strictly, so equal values never swap and it stays stable). runs
+// shorter than MIN_RUN are then grown with insertion sort so random input doesn't make n tiny runs
+// -
+// args:
+// list **head: root node of the rest of the list, moved past the run
+// run *r: gets the run
+// -
+// returns:
+// nothing
+
+void next_run(list **head, run *r) {
+    list *first = *head;
+    list *p = first;
+    r->len = 1;
+    if (p->next != NULL && p->next->value < p->value) {
+        list *prev = NULL;
+        list *next;
+        do {
+            next = p->next;
+            p->next = prev;
+            prev = p;
+            p = next;
+            r->len++;
+        } while (p->next != NULL && p->next->value < p->value);
+        // p is the last node of the run and still points on into the list
+        next = p->next;
+        p->next = prev;
+        *head = next;
+        r->head = p;
+        r->tail = first;
+        first->next = NULL;
+    }
+    else {
+        while (p->next != NULL && p->next->value >= p->value) {
+            p = p->next;
+            r->len++;
+        }
+        *head = p->next;
+        p->next = NULL;
+        r->head = first;
+        r->tail = p;
+    }
+    // insertion sort more nodes in, each one after every node with the same value
+    while (r->len < MIN_RUN && *head != NULL) {
+        list *n = *head;
+        *head = n->next;
+        if (n->value >= r->tail->value) {
+            r->tail->next = n;
+            r->tail = n;
+            n->next = NULL;
+        }
+        else if (n->value < r->head->value) {
+            n->next = r->head;
+            r->head = n;
+        }
+        else {
+            list *q = r->head;
+            while (q->next->value <= n->value) q = q->next;
+            n->next = q->next;
+            q->next = n;
+        }
+        r->len++;
+    }
+}
+
+
+// bottom function merges runs[k + 1] into runs[k] and closes the gap in the stack
+
+void merge_at(run *runs, int *n, int k) {
+    merge_runs(&runs[k], &runs[k + 1]);
+    if (k + 2 < *n) runs[k + 1] = runs[k + 2];
+    (*n)--;
+}
+
+
+// adaptive merge sort in the style of TimSort: one pass cuts the list into natural runs (see next_run()), which
+// go on a stack that's merged (see merge_runs()) whenever the lengths break TimSort's invariants
+// len[i - 2] > len[i - 1] + len[i] and len[i - 1] > len[i], so merges stay balanced and the stack stays small.
+// only neighbouring runs are merged so it's stable. an already sorted list is one run and sorts in O(n) without a
+// single link changing, and the fewer/longer the runs the less work there is
+// -
+// args:
+// list *head: root node of linked list to be sorted
+// -
+// returns:
+// root node of the sorted list
+
+list* natural_sort(list *head) {
+    if (head == NULL) return head;
+    run runs[MAX_RUNS];
+    int n = 0;
+    while (head != NULL) {
+        next_run(&head, &runs[n++]);
+        while (n > 1) {
+            int k = n - 2;
+            if ((k > 0 && runs[k - 1].len <= runs[k].len + runs[k + 1].len) ||
+                (k > 1 && runs[k - 2].len <= runs[k - 1].len + runs[k].len)) {
+                if (runs[k - 1].len < runs[k + 1].len) k--;
+            }
+            else if (runs[k].len > runs[k + 1].len) break;
+            merge_at(runs, &n, k);
+        }
+    }
+    while (n > 1) merge_at(runs, &n, n - 2);
+    return runs[0].head;
+}
+
+
+// optimal 19 comparator sorting network for 8 values, CX(a, b) has to leave min in a and max in b
+#define NETWORK_8(CX) \
+    CX(0, 2) CX(1, 3) CX(4, 6) CX(5, 7) \
+    CX(0, 4) CX(1, 5) CX(2, 6) CX(3, 7) \
+    CX(0, 1) CX(2, 3) CX(4, 5) CX(6, 7) \
+    CX(2, 4) CX(3, 5) \
+    CX(1, 4) CX(3, 6) \
+    CX(1, 2) CX(3, 4) CX(5, 6)
+
+
+// bottom function sorts 8 blocks of 8 values at once with NETWORK_8: the 64 values are looked at as 8 rows of 8,
+// row k holding value k of every block, so each comparator is one min and one max across whole rows and every
+// column ends up sorted. the blocks are then written to out one after the other (a transpose)
+// -
+// args:
+// const int *in: NETWORK_GROUP values
+// int *out: gets the 8 sorted blocks of 8
+// -
+// returns:
+// nothing
+// -
+// with AVX2 a row is one register (_mm256_min_epi32/_mm256_max_epi32), with SSE4.1 it's two. the plain C version
+// does the same thing a lane at a time, which compilers can often vectorize themselves
+
+void network_sort_64(const int *in, int *out) {
+    int rows[8][8];
+#ifdef __AVX2__
+    __m256i r[8];
+    for (int k = 0; k < 8; k++) r[k] = _mm256_loadu_si256((const __m256i *) (in + 8 * k));
+#define CX(a, b) { __m256i t = _mm256_min_epi32(r[a], r[b]); r[b] = _mm256_max_epi32(r[a], r[b]); r[a] = t; }
+    NETWORK_8(CX)
+#undef CX
+    for (int k = 0; k < 8; k++) _mm256_storeu_si256((__m256i *) rows[k], r[k]);
+#elif defined(__SSE4_1__)
+    for (int half = 0; half < 8; half += 4) {
+        __m128i r[8];
+        for (int k = 0; k < 8; k++) r[k] = _mm_loadu_si128((const __m128i *) (in + 8 * k + half));
+#define CX(a, b) { __m128i t = _mm_min_epi32(r[a], r[b]); r[b] = _mm_max_epi32(r[a], r[b]); r[a] = t; }
+        NETWORK_8(CX)
+#undef CX
+        for (int k = 0; k < 8; k++) _mm_storeu_si128((__m128i *) (rows[k] + half), r[k]);
+    }
+#else
+    memcpy(rows, in, sizeof(rows));
+#define CX(a, b) for (int l = 0; l < 8; l++) { \
+        int x = rows[a][l], y = rows[b][l]; \
+        rows[a][l] = (x < y) ? x : y; \
+        rows[b][l] = (x < y) ? y : x; \
+    }
+    NETWORK_8(CX)
+#undef CX
+#endif
+    for (int b = 0; b < 8; b++) {
+        for (int k = 0; k < 8; k++) out[8 * b + k] = rows[k][b];
+    }
+}
+
+
+// sorts an array of ints padded up to a multiple of NETWORK_GROUP: blocks of 8 are sorted by network_sort_64()
+// and then merged bottom-up, going back and forth between buf and tmp
+// -
+// args:
+// int *buf: the values, padded (with INT_MAX, so the padding ends up at the end)
+// int *tmp: scratch space of the same size
+// size_t padded: number of values, a multiple of NETWORK_GROUP
+// -
+// returns:
+// whichever of buf and tmp ended up with the sorted values
+
+int* sort_ints(int *buf, int *tmp, size_t padded) {
+    for (size_t i = 0; i < padded; i += NETWORK_GROUP) network_sort_64(buf + i, tmp + i);
+
+    // merge runs of width values from src into dst until one run covers everything
+    int *src = tmp;
+    int *dst = buf;
+    for (size_t width = 8; width < padded; width *= 2) {
+        for (size_t lo = 0; lo < padded; lo += 2 * width) {
+            size_t mid = (lo + width < padded) ? lo + width : padded;
+            size_t hi = (lo + 2 * width < padded) ? lo + 2 * width : padded;
+            size_t a = lo;
+            size_t b = mid;
+            size_t k = lo;
+            while (a < mid && b < hi) {
+                int x = src[a];
+                int y = src[b];
+                int take_b = y < x;
+                dst[k++] = take_b ? y : x;
+                b += take_b;
+                a += !take_b;
+            }
+            while (a < mid) dst[k++] = src[a++];
+            while (b < hi) dst[k++] = src[b++];
+        }
+        int *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    return src;
+}
+
+
+// gather-sort-scatter: copies the values into an array in one pass, sorts the array with sort_ints() and writes
+// the values back in a second pass, so nodes keep their addresses (and their order in memory) and only their
+// values change. not stable, but values are all a list holds so that can't show
+// -
+// args:
+// list *head: root node of linked list to be sorted
+// -
+// returns:
+// head (which now holds the smallest value), or the result of list_sort() if the buffers can't be allocated
+
+list* array_sort(list *head) {
+    size_t n = 0;
+    for (list *l = head; l != NULL; l = l->next) n++;
+    if (n < 2) return head;
+    size_t padded = (n + NETWORK_GROUP - 1) / NETWORK_GROUP * NETWORK_GROUP;
+    int *buf = malloc(padded * sizeof(int));
+    int *tmp = malloc(padded * sizeof(int));
+    if (buf == NULL || tmp == NULL) {
+        free(buf);
+        free(tmp);
+        return list_sort(head);
+    }
+    size_t i = 0;
+    for (list *l = head; l != NULL; l = l->next) buf[i++] = l->value;
+    for (; i < padded; i++) buf[i] = 2147483647;
+    int *sorted = sort_ints(buf, tmp, padded);
+    i = 0;
+    for (list *l = head; l != NULL; l = l->next) l->value = sorted[i++];
+    free(buf);
+    free(tmp);
+    return head;
+}
+
+
+// picks a sort from one pass over the list (length, value range and number of descents), going by where the
+// crossovers in sort_benchmark() are:
+// - few descents: natural_sort(), it's O(n) on sorted input and doesn't touch memory it doesn't have to
+// - short lists: list_sort(), below about 1000 nodes everything is in cache and the array's setup isn't worth it
+// - a small value range: radix_sort() with one counting pass, which beats everything else from a few hundred up
+// - everything else: array_sort(), which beats the relinking merge sorts by 1.5-2x from a few thousand nodes up
+//   since only the gather and the scatter chase pointers
+// -
+// args:
+// list *head: root node of linked list to be sorted
+// -
+// returns:
+// root node of the sorted list
+
+list* hybrid_sort(list *head) {
+    if (head == NULL) return head;
+    long long n = 1;
+    long long descents = 0;
+    int min = head->value;
+    int max = head->value;
+    for (list *l = head; l->next != NULL; l = l->next) {
+        int v = l->next->value;
+        descents += v < l->value;
+        if (v < min) min = v;
+        if (v > max) max = v;
+        n++;
+    }
+    if (descents <= n / HYBRID_NEARLY_SORTED) return natural_sort(head);
+    if (n < HYBRID_SHORT) return list_sort(head);
+    if ((unsigned) max - (unsigned) min < COUNTING_MAX) return radix_sort(head);
+    return array_sort(head);
+}
+
+
+// buffered reader for a whitespace separated stream of ints (struct int_reader typedef to int_reader)
+
+typedef struct int_reader {
+    FILE *f;
+    char buf[READ_BUF];
+    size_t len;       // bytes in buf
+    size_t pos;       // next byte to look at
+    long long offset; // offset in the stream of buf[0]
+} int_reader;
+
+
+// bottom function refills the reader's buffer once it's used up, returns 0 at the end of the stream
+
+int reader_fill(int_reader *r) {
+    if (r->pos < r->len) return 1;
+    r->offset += r->len;
+    r->len = fread(r->buf, 1, READ_BUF, r->f);
+    r->pos = 0;
+    return r->len > 0;
+}
+
+
+// reads the next int from the stream
+// -
+// args:
+// int_reader *r: the reader
+// int *out: gets the int
+// -
+// returns:
+// 1 if an int was read, 0 at the end of the stream, -1 if the next token isn't an int (or doesn't fit in one)
+
+int reader_next(int_reader *r, int *out) {
+    int c;
+    while (1) {
+        if (!reader_fill(r)) return 0;
+        c = r->buf[r->pos];
+        if (c != ' ' && c != '\n' && c != '\t' && c != '\r' && c != '\v' && c != '\f') break;
+        r->pos++;
+    }
+    int negative = (c == '-');
+    if (c == '-' || c == '+') r->pos++;
+    long long value = 0;
+    int digits = 0;
+    while (reader_fill(r)) {
+        c = r->buf[r->pos];
+        if (c < '0' || c > '9') break;
+        value = value * 10 + (c - '0');
+        if (value > 2147483648LL) return -1;
+        digits++;
+        r->pos++;
+    }
+    if (digits == 0) return -1;
+    if (reader_fill(r)) {
+        c = r->buf[r->pos];
+        if (c != ' ' && c != '\n' && c != '\t' && c != '\r' && c != '\v' && c != '\f') return -1;
+    }
+    if (negative) value = -value;
+    if (value > 2147483647) return -1;
+    *out = (int) value;
+    return 1;
+}
+
+
+// where external_sort() sends sorted values: a spill file of raw ints, a text file with one value per line, or
+// the end of a list (struct int_sink typedef to int_sink)
+
+typedef struct int_sink {
+    FILE *f;          // NULL when building a list
+    int text;         // write text rather than raw ints
+    char *buf;        // output buffer
+    size_t cap;
+    size_t len;
+    list *head;       // the list being built when f is NULL
+    list *tail;
+    long long count;
+} int_sink;
 
-    return merge(head, lo, hi);
+
+// bottom function writes out whatever is in the sink's buffer, returns 0 if the write failed
+
+int sink_flush(int_sink *s) {
+    int ok = (s->len == 0 || fwrite(s->buf, 1, s->len, s->f) == s->len);
+    s->len = 0;
+    return ok;
 }
 
 
+// bottom function adds one value to the sink, returns 0 if a write failed
+
+int sink_put(int_sink *s, int value) {
+    s->count++;
+    if (s->f == NULL) {
+        list *n = node_alloc(SITE_EXTERNAL_SORT);
+        make_list(n, value);
+        if (s->tail == NULL) s->head = n;
+        else s->tail->next = n;
+        s->tail = n;
+        return 1;
+    }
+    if (s->len + 12 > s->cap && !sink_flush(s)) return 0;
+    if (!s->text) {
+        memcpy(s->buf + s->len, &value, sizeof(int));
+        s->len += sizeof(int);
+        return 1;
+    }
+    char digits[11];
+    int d = 0;
+    unsigned magnitude = (value < 0) ? 0u - (unsigned) value : (unsigned) value;
+    do {
+        digits[d++] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) s->buf[s->len++] = '-';
+    while (d > 0) s->buf[s->len++] = digits[--d];
+    s->buf[s->len++] = '\n';
+    return 1;
+}
+
+
+// a sorted run in one of external_sort()'s spill files, read back through its own buffer when merging. every run
+// of a file shares its descriptor and reads its own byte range with pread() (struct spill_run typedef to spill_run)
+
+typedef struct spill_run {
+    int fd;
+    long long next; // byte offset of the next unread int in the file
+    long long end;  // byte offset the run ends at
+    int *buf;
+    size_t cap;     // ints buf holds
+    size_t len;     // ints in buf
+    size_t pos;     // next int in buf
+} spill_run;
+
+
+// bottom function reads the next value of a run, returns 0 once the run is used up
+
+int run_next(spill_run *r, int *out) {
+    if (r->pos == r->len) {
+        size_t want = (size_t) (r->end - r->next) / sizeof(int);
+        if (want > r->cap) want = r->cap;
+        ssize_t got = (want > 0) ? pread(r->fd, r->buf, want * sizeof(int), (off_t) r->next) : 0;
+        r->len = (got > 0) ? (size_t) got / sizeof(int) : 0;
+        r->next += (long long) (r->len * sizeof(int));
+        r->pos = 0;
+        if (r->len == 0) return 0;
+    }
+    *out = r->buf[r->pos++];
+    return 1;
+}
+
+
+// merges k runs of a spill file into a sink through a binary min-heap of each run's next value. buffers are carved
+// out of one block of budget bytes, one per run plus one for the sink (which has to have f, text, head and tail set)
+// -
+// args:
+// FILE *spill: the spill file, flushed
+// const long long *bounds: run i is the bytes [bounds[i], bounds[i + 1]) of spill
+// int k: number of runs
+// int_sink *out: where the merged values go
+// size_t budget: bytes to use for buffers
+// -
+// returns:
+// 1 on success, 0 if allocating or writing failed
+
+int kway_merge(FILE *spill, const long long *bounds, int k, int_sink *out, size_t budget) {
+    size_t share = budget / (k + 1) / sizeof(int) * sizeof(int);
+    char *block = malloc(share * (k + 1));
+    spill_run *runs = malloc(k * sizeof(spill_run));
+    int *heap_values = malloc(k * sizeof(int));
+    int *heap_runs = malloc(k * sizeof(int));
+    int ok = block != NULL && runs != NULL && heap_values != NULL && heap_runs != NULL;
+    int n = 0;
+    for (int i = 0; ok && i < k; i++) {
+        runs[i] = (spill_run) {fileno(spill), bounds[i], bounds[i + 1], (int *) (block + share * i),
+                               share / sizeof(int), 0, 0};
+        int value;
+        if (!run_next(&runs[i], &value)) continue;
+        // sift up
+        int c = n++;
+        while (c > 0 && heap_values[(c - 1) / 2] > value) {
+            heap_values[c] = heap_values[(c - 1) / 2];
+            heap_runs[c] = heap_runs[(c - 1) / 2];
+            c = (c - 1) / 2;
+        }
+        heap_values[c] = value;
+        heap_runs[c] = i;
+    }
+    if (ok) {
+        out->buf = block + share * k;
+        out->cap = share;
+        out->len = 0;
+    }
+    while (ok && n > 0) {
+        ok = sink_put(out, heap_values[0]);
+        int r = heap_runs[0];
+        int value;
+        if (!run_next(&runs[r], &value)) {
+            value = heap_values[--n];
+            r = heap_runs[n];
+        }
+        // sift the replacement down from the top
+        int c = 0;
+        while (2 * c + 1 < n) {
+            int child = 2 * c + 1;
+            if (child + 1 < n && heap_values[child + 1] < heap_values[child]) child++;
+            if (heap_values[child] >= value) break;
+            heap_values[c] = heap_values[child];
+            heap_runs[c] = heap_runs[child];
+            c = child;
+        }
+        heap_values[c] = value;
+        heap_runs[c] = r;
+    }
+    if (ok && out->f != NULL) ok = sink_flush(out);
+    free(block);
+    free(runs);
+    free(heap_values);
+    free(heap_runs);
+    return ok;
+}
+
+
+// external merge sort for more ints than fit in memory, in two phases:
+// - runs: ints are read into a buffer until the budget is used up, sorted with sort_ints() and appended as raw ints
+//   to one tmpfile() (deleted automatically when it's closed), keeping the offset every run starts at
+// - merge: up to budget / MERGE_BUF_MIN - 1 runs at a time are merged by kway_merge() with large sequential read
+//   buffers. if there are more runs than that, a pass merges them in groups of that many into a second spill file,
+//   which then replaces the first. at most two spill files are open at a time, so any input size works with a
+//   fixed budget and a fixed number of file descriptors
+// peak memory is about budget bytes no matter how big the input is (plus the list, if the output goes into one).
+// input that fits in one run is never spilled
+// -
+// args:
+// const char *in_path: whitespace separated ints, "-" for stdin
+// const char *out_path: file to write the sorted ints to (one per line), or NULL to put them in a list
+// size_t budget: memory budget in bytes (at least EXT_MIN_BUDGET)
+// list **out: gets the sorted list if out_path is NULL
+// -
+// returns:
+// number of ints sorted, or -1 on an error (which has been printed)
+
+long long external_sort(const char *in_path, const char *out_path, size_t budget, list **out) {
+    if (budget < EXT_MIN_BUDGET) budget = EXT_MIN_BUDGET;
+    int_reader *reader = malloc(sizeof(int_reader));
+    if (reader == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    reader->f = (strcmp(in_path, "-") == 0) ? stdin : fopen(in_path, "rb");
+    reader->len = reader->pos = 0;
+    reader->offset = 0;
+    if (reader->f == NULL) {
+        fprintf(stderr, "could not open %s\n", in_path);
+        free(reader);
+        return -1;
+    }
+    int_sink sink = {NULL, 1, NULL, 0, 0, NULL, NULL, 0};
+    if (out_path != NULL && (sink.f = fopen(out_path, "wb")) == NULL) {
+        fprintf(stderr, "could not open %s\n", out_path);
+        if (reader->f != stdin) fclose(reader->f);
+        free(reader);
+        return -1;
+    }
+
+    // run phase: the run buffer and sort_ints()'s scratch space share what the reader leaves of the budget
+    size_t run_cap = (budget - sizeof(int_reader)) / (2 * sizeof(int)) / NETWORK_GROUP * NETWORK_GROUP;
+    int *buf = malloc(run_cap * sizeof(int));
+    int *tmp = malloc(run_cap * sizeof(int));
+    int max_fan_in = (int) (budget / MERGE_BUF_MIN) - 1;
+    int runs_cap = 16;
+    long long *bounds = malloc((runs_cap + 1) * sizeof(long long));
+    FILE *spill = NULL;
+    int num_runs = 0;
+    int status = (buf != NULL && tmp != NULL && bounds != NULL) ? 1 : 0;
+    if (!status) fprintf(stderr, "out of memory\n");
+    int more = 1;
+    long long total = 0;
+    while (status == 1 && more) {
+        size_t n = 0;
+        int value;
+        while (n < run_cap && (more = reader_next(reader, &value)) == 1) buf[n++] = value;
+        if (more == -1) {
+            fprintf(stderr, "parse error at byte offset %lld: expected an int\n",
+                    reader->offset + (long long) reader->pos);
+            status = 0;
+            break;
+        }
+        if (n == 0) break;
+        total += n;
+        size_t padded = (n + NETWORK_GROUP - 1) / NETWORK_GROUP * NETWORK_GROUP;
+        for (size_t i = n; i < padded; i++) buf[i] = 2147483647;
+        int *sorted = sort_ints(buf, tmp, padded);
+        if (num_runs == 0 && !more) {
+            // everything fit in one run, no need to spill it
+            sink.buf = (char *) ((sorted == buf) ? tmp : buf);
+            sink.cap = run_cap * sizeof(int);
+            for (size_t i = 0; i < n && status; i++) status = sink_put(&sink, sorted[i]);
+            if (status && sink.f != NULL) status = sink_flush(&sink);
+            if (!status) fprintf(stderr, "could not write the output\n");
+            status = status ? 2 : 0;
+            break;
+        }
+        if (num_runs == runs_cap) {
+            runs_cap *= 2;
+            long long *grown = realloc(bounds, (runs_cap + 1) * sizeof(long long));
+            if (grown == NULL) {
+                fprintf(stderr, "out of memory\n");
+                status = 0;
+                break;
+            }
+            bounds = grown;
+        }
+        if (spill == NULL) {
+            spill = tmpfile();
+            bounds[0] = 0;
+        }
+        if (spill == NULL || fwrite(sorted, sizeof(int), n, spill) != n) {
+            fprintf(stderr, "could not write a spill file\n");
+            status = 0;
+            break;
+        }
+        num_runs++;
+        bounds[num_runs] = bounds[num_runs - 1] + (long long) (n * sizeof(int));
+    }
+    free(buf);
+    free(tmp);
+    if (reader->f != stdin) fclose(reader->f);
+    free(reader);
+
+    // merge phase: merge groups of max_fan_in runs into a new spill file until one pass can take them all
+    if (status == 1 && spill != NULL && fflush(spill) != 0) {
+        fprintf(stderr, "could not write a spill file\n");
+        status = 0;
+    }
+    while (status == 1 && num_runs > max_fan_in) {
+        int_sink next = {tmpfile(), 0, NULL, 0, 0, NULL, NULL, 0};
+        if (next.f == NULL) {
+            fprintf(stderr, "could not create a spill file\n");
+            status = 0;
+            break;
+        }
+        // the merged runs' bounds are written over the old ones, which are always read first
+        int merged = 0;
+        for (int i = 0; status == 1 && i < num_runs; i += max_fan_in) {
+            int k = (num_runs - i < max_fan_in) ? num_runs - i : max_fan_in;
+            status = kway_merge(spill, bounds + i, k, &next, budget);
+            bounds[++merged] = next.count * (long long) sizeof(int);
+        }
+        if (status == 1 && fflush(next.f) != 0) status = 0;
+        fclose(spill);
+        spill = next.f;
+        if (status != 1) {
+            fprintf(stderr, "could not write a spill file\n");
+            break;
+        }
+        num_runs = merged;
+    }
+    if (status == 1 && num_runs > 0) {
+        status = kway_merge(spill, bounds, num_runs, &sink, budget);
+        if (!status) fprintf(stderr, "could not write the output\n");
+    }
+    if (spill != NULL) fclose(spill);
+    free(bounds);
+    if (sink.f != NULL && fclose(sink.f) != 0 && status) {
+        fprintf(stderr, "could not write the output\n");
+        status = 0;
+    }
+    if (!status) {
+        free_list(sink.head, SITE_EXTERNAL_SORT);
+        return -1;
+    }
+    if (out != NULL) *out = sink.head;
+    return total;
+}
+
+
+// node of an index_list: a value and the index of the next node instead of a pointer (typedef to just inode)
+// 8 bytes instead of list's 16 on 64 bit builds
+
+typedef struct inode {
+    int value;
+    unsigned next;
+} inode;
+
+
+// compact list storage (typedef to just index_list): every node lives in one growable array and links are 32 bit
+// indexes into it, NIL marking the end. deleted slots are kept on a free list (chained through next) and handed
+// out again before the array grows. since there are no pointers in it the whole thing can be written to disk and
+// read back as it is (see ilist_save() and ilist_load())
+
+typedef struct index_list {
+    inode *nodes;
+    unsigned cap;       // slots in nodes
+    unsigned used;      // slots that have ever been handed out, the rest of nodes is untouched
+    unsigned head;      // first node of the list
+    unsigned free;      // first free slot
+    unsigned length;    // nodes in the list
+} index_list;
+
+
+// bottom function sets up an empty index_list with room for cap nodes (at least 1)
+// nodes is one allocation as far as alloc_stats goes, growing it only changes the bytes
+
+void ilist_init(index_list *l, unsigned cap) {
+    if (cap == 0) cap = 1;
+    l->nodes = my_malloc((size_t) cap * sizeof(inode), SITE_INDEX_LIST);
+    if (l->nodes == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    l->cap = cap;
+    l->used = 0;
+    l->head = l->free = NIL;
+    l->length = 0;
+}
+
+
+// bottom function frees the index_list's array
+
+void ilist_free(index_list *l) {
+    my_free(l->nodes, (size_t) l->cap * sizeof(inode), SITE_INDEX_LIST);
+    l->nodes = NULL;
+}
+
+
+// bottom function hands out a slot, from the free list if there is one, doubling the array if it's full
+// -
+// returns:
+// index of the slot
+
+unsigned ilist_alloc(index_list *l) {
+    if (l->free != NIL) {
+        unsigned i = l->free;
+        l->free = l->nodes[i].next;
+        return i;
+    }
+    if (l->used == l->cap) {
+        unsigned cap = (l->cap < 0x80000000u) ? l->cap * 2 : NIL - 1;
+        inode *nodes = realloc(l->nodes, (size_t) cap * sizeof(inode));
+        if (nodes == NULL || l->used == cap) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        stats_resize(SITE_INDEX_LIST, (long long) (cap - l->cap) * sizeof(inode));
+        l->nodes = nodes;
+        l->cap = cap;
+    }
+    return l->used++;
+}
+
+
+// ilist version of append(): puts data at the front of the list
+
+void ilist_append(index_list *l, int data) {
+    unsigned i = ilist_alloc(l);
+    l->nodes[i].value = data;
+    l->nodes[i].next = l->head;
+    l->head = i;
+    l->length++;
+}
+
+
+// ilist version of fromarray(): builds the list in one pass over the array, front to back, so the slots end up in
+// list order (l has to be empty)
+
+void ilist_fromarray(index_list *l, int (*arr)[], int size) {
+    unsigned prev = NIL;
+    for (int i = 0; i < size; i++) {
+        unsigned n = ilist_alloc(l);
+        l->nodes[n].value = (*arr)[i];
+        l->nodes[n].next = NIL;
+        if (prev == NIL) l->head = n;
+        else l->nodes[prev].next = n;
+        prev = n;
+    }
+    l->length += size;
+}
 
-int main() {
+
+// deletes the node after prev (or the head if prev is NIL) and puts its slot on the free list
+
+void ilist_delete_after(index_list *l, unsigned prev) {
+    unsigned n = (prev == NIL) ? l->head : l->nodes[prev].next;
+    if (n == NIL) return;
+    if (prev == NIL) l->head = l->nodes[n].next;
+    else l->nodes[prev].next = l->nodes[n].next;
+    l->nodes[n].next = l->free;
+    l->free = n;
+    l->length--;
+}
+
+
+// ilist version of print_list()
+
+void ilist_print(index_list *l) {
+    int count = 0;
+    for (unsigned i = l->head; i != NIL; i = l->nodes[i].next) {
+        count++;
+        printf("%6d ", l->nodes[i].value);
+        if (count == 5) {
+            count = 0;
+            printf("\n");
+        }
+    }
+    if (count % 5 != 0) printf("\n");
+}
+
+
+// ilist version of merge_sorted(): merges two sorted chains of indexes, stable
+
+unsigned ilist_merge(inode *nodes, unsigned a, unsigned b) {
+    unsigned head = NIL;
+    unsigned tail = NIL;
+    while (a != NIL && b != NIL) {
+        unsigned take;
+        if (nodes[b].value < nodes[a].value) {
+            take = b;
+            b = nodes[b].next;
+        }
+        else {
+            take = a;
+            a = nodes[a].next;
+        }
+        if (tail == NIL) head = take;
+        else nodes[tail].next = take;
+        tail = take;
+    }
+    unsigned rest = (a != NIL) ? a : b;
+    if (tail == NIL) return rest;
+    nodes[tail].next = rest;
+    return head;
+}
+
+
+// ilist version of list_sort(): the same bottom-up relinking merge sort with 64 run bins, on indexes
+
+void ilist_sort(index_list *l) {
+    unsigned bins[SORT_BINS];
+    int used = 0;
+    unsigned head = l->head;
+    while (head != NIL) {
+        unsigned run = head;
+        head = l->nodes[head].next;
+        l->nodes[run].next = NIL;
+        int i = 0;
+        for (; i < used && bins[i] != NIL; i++) {
+            run = ilist_merge(l->nodes, bins[i], run);
+            bins[i] = NIL;
+        }
+        bins[i] = run;
+        if (i == used) used++;
+    }
+    unsigned sorted = NIL;
+    for (int i = 0; i < used; i++) {
+        if (bins[i] != NIL) sorted = ilist_merge(l->nodes, bins[i], sorted);
+    }
+    l->head = sorted;
+}
+
+
+// writes an index_list to a file: INDEX_MAGIC, the header fields (cap, used, head, free, length) as 32 bit ints and
+// then the used slots as they are. ints are in the machine's byte order
+// -
+// returns:
+// 0, or -1 if the file couldn't be written
+
+int ilist_save(index_list *l, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return -1;
+    unsigned header[5] = {l->cap, l->used, l->head, l->free, l->length};
+    int ok = fwrite(INDEX_MAGIC, 1, 4, f) == 4 && fwrite(header, sizeof(unsigned), 5, f) == 5 &&
+             fwrite(l->nodes, sizeof(inode), l->used, f) == l->used;
+    if (fclose(f) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
+
+
+// bottom function checks that every index in an index_list read from a file is a slot below used or NIL, that the
+// list takes exactly length steps to walk and that the free list ends without touching a slot of the list, so a
+// corrupt or truncated file can't make a later traversal or insert go out of bounds
+// -
+// returns:
+// 1 if l is consistent, 0 if it isn't (or there's no memory to check it)
+
+int ilist_valid(index_list *l) {
+    if ((l->head != NIL && l->head >= l->used) || (l->free != NIL && l->free >= l->used) || l->length > l->used) {
+        return 0;
+    }
+    for (unsigned i = 0; i < l->used; i++) {
+        if (l->nodes[i].next != NIL && l->nodes[i].next >= l->used) return 0;
+    }
+    // a free slot that's also in the list would be handed out by ilist_alloc() while it's still linked in
+    unsigned char *taken = calloc(l->used ? l->used : 1, 1);
+    if (taken == NULL) return 0;
+    unsigned steps = 0;
+    int ok = 1;
+    for (unsigned i = l->head; ok && i != NIL; i = l->nodes[i].next) {
+        if (++steps > l->length) ok = 0;
+        else taken[i] = 1;
+    }
+    if (steps != l->length) ok = 0;
+    for (unsigned i = l->free; ok && i != NIL; i = l->nodes[i].next) {
+        if (taken[i]) ok = 0;
+        else taken[i] = 1;
+    }
+    free(taken);
+    return ok;
+}
+
+
+// bottom function checks that the rest of f is at least bytes long, so a corrupt header can't make ilist_load()
+// allocate (or read) more than the file holds
+// -
+// returns:
+// 1 if it is, 0 if it isn't or f can't be seeked
+
+int ilist_fits(FILE *f, unsigned long long bytes) {
+    long pos = ftell(f);
+    if (pos < 0 || fseek(f, 0, SEEK_END) != 0) return 0;
+    long end = ftell(f);
+    if (end < 0 || fseek(f, pos, SEEK_SET) != 0) return 0;
+    return (unsigned long long) (end - pos) >= bytes;
+}
+
+
+// reads an index_list written by ilist_save() into l (which shouldn't hold a list, it gets a new array). the array
+// is sized to the used slots the file actually holds rather than the saved cap, which is only how far the saved
+// list had grown
+// -
+// returns:
+// 0, or -1 if the file couldn't be read, isn't an index_list or doesn't pass ilist_valid()
+
+int ilist_load(index_list *l, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return -1;
+    char magic[4];
+    unsigned header[5];
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, INDEX_MAGIC, 4) != 0 ||
+        fread(header, sizeof(unsigned), 5, f) != 5 || header[1] > header[0] || header[1] == NIL ||
+        !ilist_fits(f, (unsigned long long) header[1] * sizeof(inode))) {
+        fclose(f);
+        return -1;
+    }
+    ilist_init(l, header[1]);
+    l->used = header[1];
+    l->head = header[2];
+    l->free = header[3];
+    l->length = header[4];
+    int ok = fread(l->nodes, sizeof(inode), l->used, f) == l->used && ilist_valid(l);
+    fclose(f);
+    if (!ok) ilist_free(l);
+    return ok ? 0 : -1;
+}
+
+
+// index_main() is main() for the index_list (-i): builds it from the array, sorts it with ilist_sort() and, if
+// save_path isn't NULL, writes it out with ilist_save() and checks it reads back the same
+
+int index_main(int (*arr)[], int size, const char *save_path) {
+    index_list l;
+    ilist_init(&l, size);
+    ilist_fromarray(&l, arr, size);
+    if (size <= PRINT_LIMIT) {
+        printf("\noriginal array:\n");
+        ilist_print(&l);
+    }
+    double start = now_seconds();
+    ilist_sort(&l);
+    double elapsed = now_seconds() - start;
+    printf("\n\n");
+    if (size <= PRINT_LIMIT) {
+        printf("after sorting: \n");
+        ilist_print(&l);
+    }
+    int sorted = 1;
+    for (unsigned i = l.head; i != NIL && l.nodes[i].next != NIL; i = l.nodes[i].next) {
+        if (l.nodes[l.nodes[i].next].value < l.nodes[i].value) sorted = 0;
+    }
+    printf("\n%d elements sorted with ilist_sort in %.3fs (%s), %zu bytes per element", size, elapsed,
+           sorted ? "sorted" : "NOT SORTED", sizeof(inode));
+    if (save_path != NULL) {
+        index_list copy;
+        int same = ilist_save(&l, save_path) == 0 && ilist_load(&copy, save_path) == 0;
+        if (same) {
+            unsigned a = l.head;
+            unsigned b = copy.head;
+            while (a != NIL && b != NIL && l.nodes[a].value == copy.nodes[b].value) {
+                a = l.nodes[a].next;
+                b = copy.nodes[b].next;
+            }
+            same = (a == NIL && b == NIL);
+            ilist_free(&copy);
+        }
+        printf("\nsaved to %s (%s)", save_path, same ? "reads back the same" : "FAILED");
+    }
+    ilist_free(&l);
+    printf("\n\n%lld memory leaks\n\n", alloc_live());
+    return 0;
+}
+
+
+// comparison function for qsort() on ints
+
+int int_compare(const void *a, const void *b) {
+    int x = *(const int*) a;
+    int y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+
+// returns 1 if the list is in ascending order, 0 otherwise
+
+int is_sorted(list *head) {
+    while (head != NULL && head->next != NULL) {
+        if (head->next->value < head->value) return 0;
+        head = head->next;
+    }
+    return 1;
+}
+
+
+// times every sort on random lists of n = 16, 64, 256, ... up to max_size values in [0-range], so the crossovers
+// hybrid_sort() goes by can be checked on a given machine. small sizes are repeated so each one sorts at least
+// about 4M values in total, and the lists are rebuilt from the pool before every run so nodes end up scattered
+// like they would be in a long running program. prints nanoseconds per value for each sort
+// -
+// args:
+// int max_size: largest list to sort
+// int range: values are in [0-range]
+// -
+// returns:
+// 0, or 1 if a sort got something wrong
+
+int sort_benchmark(int max_size, int range) {
+    list* (*sorts[])(list*) = {list_sort, natural_sort, radix_sort, array_sort, hybrid_sort};
+    const char *names[] = {"list_sort", "natural_sort", "radix_sort", "array_sort", "hybrid_sort"};
+    int num_sorts = sizeof(sorts) / sizeof(sorts[0]);
+    int (*a)[] = malloc(sizeof(int) * (size_t) max_size);
+    if (a == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    srand(12345);
+    printf("ns per value, values in [0-%d]\n%10s", range, "n");
+    for (int k = 0; k < num_sorts; k++) printf(" %13s", names[k]);
+    printf("\n");
+    for (long long n = 16; n <= max_size; n *= 4) {
+        for (int i = 0; i < n; i++) (*a)[i] = rand() % (range + 1);
+        long long reps = 4000000 / n + 1;
+        printf("%10lld", n);
+        for (int k = 0; k < num_sorts; k++) {
+            double elapsed = 0;
+            for (long long r = 0; r < reps; r++) {
+                list *root = fromarray(NULL, a, (int) n);
+                double start = now_seconds();
+                root = sorts[k](root);
+                elapsed += now_seconds() - start;
+                if (!is_sorted(root)) {
+                    fprintf(stderr, "\n%s didn't sort a list of %lld\n", names[k], n);
+                    free(a);
+                    return 1;
+                }
+                free_list(root, SITE_APPEND);
+            }
+            printf(" %13.1f", elapsed / (reps * n) * 1e9);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    free(a);
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    // usage: linked_list [-n size] [-r range] [-N] [-o | -p threads | -R | -a | -g | -h]
+    //        linked_list -B [-n max_size] [-r range]
+    //        linked_list -x in out [-M mib]
+    //        linked_list -i [-n size] [-r range] [-N] [-I file]
+    //        any of them [-A file]
+    // (build with alloc_stats.c and -pthread, add -DALLOC_STATS=0 to compile the allocation counters out)
+    // -n sets the number of elements in the list (default ARR_SIZE)
+    // -r sets the range of the random values, [0-range] inclusive (default RANGE)
+    // -o sorts with the old copying msort() instead of list_sort() (only usable for small lists)
+    // -p sorts on that many threads with parallel_sort() (0 = one per core)
+    // -R sorts with radix_sort() (counting/radix sort, no comparisons)
+    // -a sorts with natural_sort() (adaptive, cheap on nearly sorted lists)
+    // -g sorts with array_sort() (gather into an array, sort, scatter back, nodes stay where they are)
+    // -h sorts with hybrid_sort(), which picks one of the sorts above from the length and values of the list
+    // -B runs sort_benchmark() up to max_size (default 4194304) instead
+    // -x sorts the ints in the file in (whitespace separated, "-" for stdin) with external_sort() into out, one per
+    //    line. an out of "-" loads them into a list instead, which is then printed/checked like the others
+    // -M sets external_sort()'s memory budget in MiB (default 64)
+    // -i uses an index_list (32 bit index links in one array) sorted with ilist_sort() instead, see index_main().
+    //    -I also saves it to file and reads it back
+    // -N makes the input nearly sorted: sorted, then one element in 100 swapped with a random one
+    // -A writes an alloc_stats snapshot (JSON) to file when the program exits, "-" for stdout
+    // lists longer than PRINT_LIMIT aren't printed, only checked
+    int size = ARR_SIZE;
+    int range = RANGE;
+    int old_sort = 0;
+    int threads = -1;
+    int radix = 0;
+    int adaptive = 0;
+    int nearly_sorted = 0;
+    int gather = 0;
+    int hybrid = 0;
+    int benchmark = 0;
+    int size_given = 0;
+    const char *external_in = NULL;
+    const char *external_out = NULL;
+    int budget_mib = 64;
+    int use_index = 0;
+    const char *index_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+            size_given = 1;
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) range = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0) old_sort = 1;
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-R") == 0) radix = 1;
+        else if (strcmp(argv[i], "-a") == 0) adaptive = 1;
+        else if (strcmp(argv[i], "-N") == 0) nearly_sorted = 1;
+        else if (strcmp(argv[i], "-g") == 0) gather = 1;
+        else if (strcmp(argv[i], "-h") == 0) hybrid = 1;
+        else if (strcmp(argv[i], "-B") == 0) benchmark = 1;
+        else if (strcmp(argv[i], "-x") == 0 && i + 2 < argc) {
+            external_in = argv[++i];
+            external_out = argv[++i];
+        }
+        else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) budget_mib = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0) use_index = 1;
+        else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc) index_path = argv[++i];
+        else if (strcmp(argv[i], "-A") == 0 && i + 1 < argc) stats_path = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [-n size] [-r range] [-N] [-o | -p threads | -R | -a | -g | -h]\n"
+                            "       %s -B [-n max_size] [-r range]\n"
+                            "       %s -x in out [-M mib]\n"
+                            "       %s -i [-n size] [-r range] [-N] [-I file]\n"
+                            "       any of them [-A file]\n", argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (threads == 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    alloc_stats_sites(site_names, SITES);
+    atexit(dump_stats_at_exit);
+    if (benchmark) {
+        int status = sort_benchmark(size_given ? size : 4194304, range);
+        pool_release();
+        return status;
+    }
+    if (external_in != NULL) {
+        int to_list = strcmp(external_out, "-") == 0;
+        size_t budget = (size_t) (budget_mib > 0 ? budget_mib : 1) << 20;
+        list *root = NULL;
+        double start = now_seconds();
+        long long sorted = external_sort(external_in, to_list ? NULL : external_out, budget, &root);
+        double elapsed = now_seconds() - start;
+        if (sorted < 0) return 1;
+        if (to_list && sorted <= PRINT_LIMIT) print_list(root);
+        printf("\n%lld ints sorted with external_sort in %.3fs (%d MiB budget)", sorted, elapsed, budget_mib);
+        if (to_list) printf(" (%s)", is_sorted(root) ? "sorted" : "NOT SORTED");
+        free_list(root, SITE_EXTERNAL_SORT);
+        int leaked = pool_release();
+        printf("\n%d nodes still in the pool\n\n%lld memory leaks\n\n", leaked, alloc_live());
+        return 0;
+    }
+    if (size < 1 || range < 0) {
+        fprintf(stderr, "size has to be at least 1 and range can't be negative\n");
+        return 1;
+    }
 
     // set a random seed at the beginning of each run
     // this ensures that it's not the exact same sequence of numbers in the array everytime you run the program
     srand((unsigned) time(NULL)); 
     
-    // declare and initialize array with random values using rand() 
-    int a[ARR_SIZE];
-    for (int i = 0; i < ARR_SIZE; i++) {
-        a[i] = rand() % (RANGE + 1);
+    // declare and initialize array with random values using rand() (on the heap since size can be huge)
+    int (*a)[] = malloc(sizeof(int) * (size_t) size);
+    if (a == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < size; i++) {
+        (*a)[i] = rand() % (range + 1);
+    }
+    if (nearly_sorted) {
+        qsort(a, size, sizeof(int), int_compare);
+        for (int i = 0; i < size / 100; i++) {
+            int x = rand() % size;
+            int y = rand() % size;
+            int temp = (*a)[x];
+            (*a)[x] = (*a)[y];
+            (*a)[y] = temp;
+        }
+    }
+
+    if (use_index) {
+        int status = index_main(a, size, index_path);
+        free(a);
+        return status;
     }
 
     // initialize linked list and assign its root node to list *root
     list *root = NULL;
-    int size = sizeof(a) / sizeof(a[0]);
-    root = fromarray(root, &a, size); 
+    root = fromarray(root, a, size); 
+    alloc_site root_site = SITE_APPEND;
+    free(a);
 
     // print the list prior to sorting
-    printf("\noriginal array:\n");
-    print_list(root);
-    root = msort(root, 0, size - 1);
+    if (size <= PRINT_LIMIT) {
+        printf("\noriginal array:\n");
+        print_list(root);
+    }
+    double start = now_seconds();
+    const char *sort_name = "list_sort";
+    if (old_sort) {
+        root = msort(root, 0, size - 1, &root_site);
+        sort_name = "msort";
+    }
+    else if (gather) {
+        root = array_sort(root);
+        sort_name = "array_sort";
+    }
+    else if (hybrid) {
+        root = hybrid_sort(root);
+        sort_name = "hybrid_sort";
+    }
+    else if (adaptive) {
+        root = natural_sort(root);
+        sort_name = "natural_sort";
+    }
+    else if (radix) {
+        root = radix_sort(root);
+        sort_name = "radix_sort";
+    }
+    else if (threads > 0) {
+        root = parallel_sort(root, threads);
+        sort_name = "parallel_sort";
+    }
+    else root = list_sort(root);
+    double elapsed = now_seconds() - start;
     printf("\n\n");
     // print list after sorting
-    printf("after sorting: \n");
-    print_list(root);
+    if (size <= PRINT_LIMIT) {
+        printf("after sorting: \n");
+        print_list(root);
+    }
+    printf("\n%d elements sorted with %s in %.3fs (%s)", size, sort_name, elapsed,
+           is_sorted(root) ? "sorted" : "NOT SORTED");
 
-    // free linked list by passing its root node to free_list() (see line 134)
-    free_list(root);
+    // hand the sorted list back, then give the (now empty) slabs back in one go with pool_release()
+    free_list(root, root_site);
+    int leaked = pool_release();
+    printf("\n\n%d nodes still in the pool (should be 0)", leaked);
     // this should hopefully say "0 memory leaks"
-    printf("\n\n%d memory leaks\n\n", malloc_num);
+    printf("\n\n%lld memory leaks\n\n", alloc_live());
     return 0;
 }